@@ -0,0 +1,246 @@
+/*
+MIT License
+
+Copyright(c) 2021 James Edward Anhalt III - https://github.com/jeaiii/ce
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "ce/ce.h"
+
+#if CE_CPU_X86_64
+
+#define CE_CRC32C_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define CE_CRC32C_TARGET __attribute__((target("sse4.2,pclmul")))
+#else
+#define CE_CRC32C_TARGET
+#endif
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+
+#define CE_CRC32C_ARM 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CE_CRC32C_TARGET
+#else
+#include <arm_acle.h>
+#if defined(__clang__)
+#define CE_CRC32C_TARGET __attribute__((target("crc")))
+#else
+#define CE_CRC32C_TARGET __attribute__((target("+crc")))
+#endif
+#endif
+#if defined(__linux__) && !defined(__ARM_FEATURE_CRC32)
+#include <sys/auxv.h>
+#endif
+
+#endif
+
+namespace ce
+{
+    namespace
+    {
+        using crc32c_fn = crc32c_t(crc32c_t c, size_t n, uint8_t const p[]);
+
+        constexpr uint32_t polynomial = uint32_t(crc32c_t::polynomial);
+
+        // a * b mod p, bit 31 is x^0 as in the reflected crc
+        constexpr uint32_t multiply(uint32_t a, uint32_t b)
+        {
+            uint32_t v = 0;
+            for (uint32_t m = 0x80000000u; m != 0; m /= 2)
+            {
+                if (a & m)
+                    v ^= b;
+                b = b / 2 ^ b % 2 * polynomial;
+            }
+            return v;
+        }
+
+        // x^n mod p
+        constexpr uint32_t x_pow(size_t n)
+        {
+            uint32_t v = 0x80000000u;
+            for (uint32_t s = 0x40000000u; n > 0; n /= 2, s = multiply(s, s))
+                if (n % 2 != 0)
+                    v = multiply(v, s);
+            return v;
+        }
+
+        // the crc instructions have a 3 cycle latency and 1 cycle throughput, so 3 independent streams
+        // over adjacent blocks keep them busy, the stream crcs are then shifted past the blocks after them
+        // and combined, long blocks for big inputs then short blocks for what is left
+        constexpr size_t long_block = 4096;
+        constexpr size_t short_block = 256;
+
+        inline uint64_t load64(uint8_t const p[])
+        {
+            uint64_t v;
+            CE_MEMCPY(&v, p, sizeof(v));
+            return v;
+        }
+
+        // slicing by 8 tables, copied out to words so the source needs no alignment
+        crc32c_t crc32c_table(crc32c_t c, size_t n, uint8_t const p[])
+        {
+            uint64_t words[64];
+            for (; n >= sizeof(words); n -= sizeof(words), p += sizeof(words))
+            {
+                CE_MEMCPY(words, p, sizeof(words));
+                c = crc32(c, 64, words);
+            }
+            return crc32(c, n, p);
+        }
+
+#if CE_CRC32C_X86
+
+        // c * x^(8 L) with k = x^(8 L - 33), the carry less product is c * k * x and the crc of it
+        // as a 64 bit word multiplies by x^32 and reduces
+        CE_CRC32C_TARGET inline uint32_t shift_sse42(uint64_t c, uint32_t k)
+        {
+            __m128i m = _mm_clmulepi64_si128(_mm_cvtsi32_si128(int(uint32_t(c))), _mm_cvtsi32_si128(int(k)), 0);
+            return uint32_t(_mm_crc32_u64(0, uint64_t(_mm_cvtsi128_si64(m))));
+        }
+
+        template<size_t L> CE_CRC32C_TARGET inline uint32_t interleave_sse42(uint32_t v, size_t& n, uint8_t const*& p)
+        {
+            constexpr uint32_t k1 = x_pow(8 * L - 33);
+            constexpr uint32_t k2 = x_pow(16 * L - 33);
+
+            for (; n >= 3 * L; n -= 3 * L, p += 3 * L)
+            {
+                uint64_t a = v;
+                uint64_t b = 0;
+                uint64_t c = 0;
+                for (size_t i = 0; i < L; i += 8)
+                {
+                    a = _mm_crc32_u64(a, load64(p + i));
+                    b = _mm_crc32_u64(b, load64(p + L + i));
+                    c = _mm_crc32_u64(c, load64(p + 2 * L + i));
+                }
+                v = shift_sse42(a, k2) ^ shift_sse42(b, k1) ^ uint32_t(c);
+            }
+            return v;
+        }
+
+        CE_CRC32C_TARGET crc32c_t crc32c_sse42(crc32c_t c, size_t n, uint8_t const p[])
+        {
+            uint32_t v = ~uint32_t(c);
+
+            v = interleave_sse42<long_block>(v, n, p);
+            v = interleave_sse42<short_block>(v, n, p);
+
+            uint64_t w = v;
+            for (; n >= 8; n -= 8, p += 8)
+                w = _mm_crc32_u64(w, load64(p));
+            v = uint32_t(w);
+            for (; n > 0; --n)
+                v = _mm_crc32_u8(v, *p++);
+
+            return crc32c_t(~v);
+        }
+
+        crc32c_fn* crc32c_select()
+        {
+            unsigned int r[4]{ };
+#if defined(_MSC_VER)
+            __cpuid(reinterpret_cast<int*>(r), 1);
+#else
+            __get_cpuid(1, &r[0], &r[1], &r[2], &r[3]);
+#endif
+            // ecx bit 20 sse4.2, bit 1 pclmulqdq
+            return (r[2] >> 20 & 1) != 0 && (r[2] >> 1 & 1) != 0 ? crc32c_sse42 : crc32c_table;
+        }
+
+#elif CE_CRC32C_ARM
+
+        // no carry less multiply needed here, shifting past a block is a plain multiply by x^(8 L)
+        template<size_t L> CE_CRC32C_TARGET inline uint32_t interleave_armv8(uint32_t v, size_t& n, uint8_t const*& p)
+        {
+            constexpr uint32_t k1 = x_pow(8 * L);
+            constexpr uint32_t k2 = x_pow(16 * L);
+
+            for (; n >= 3 * L; n -= 3 * L, p += 3 * L)
+            {
+                uint32_t a = v;
+                uint32_t b = 0;
+                uint32_t c = 0;
+                for (size_t i = 0; i < L; i += 8)
+                {
+                    a = __crc32cd(a, load64(p + i));
+                    b = __crc32cd(b, load64(p + L + i));
+                    c = __crc32cd(c, load64(p + 2 * L + i));
+                }
+                v = multiply(a, k2) ^ multiply(b, k1) ^ c;
+            }
+            return v;
+        }
+
+        CE_CRC32C_TARGET crc32c_t crc32c_armv8(crc32c_t c, size_t n, uint8_t const p[])
+        {
+            uint32_t v = ~uint32_t(c);
+
+            v = interleave_armv8<long_block>(v, n, p);
+            v = interleave_armv8<short_block>(v, n, p);
+
+            for (; n >= 8; n -= 8, p += 8)
+                v = __crc32cd(v, load64(p));
+            for (; n > 0; --n)
+                v = __crc32cb(v, *p++);
+
+            return crc32c_t(~v);
+        }
+
+        crc32c_fn* crc32c_select()
+        {
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__) || defined(_M_ARM64)
+            return crc32c_armv8;
+#elif defined(__linux__)
+            // HWCAP_CRC32
+            return (getauxval(AT_HWCAP) & (1ul << 7)) != 0 ? crc32c_armv8 : crc32c_table;
+#else
+            return crc32c_table;
+#endif
+        }
+
+#else
+
+        crc32c_fn* crc32c_select()
+        {
+            return crc32c_table;
+        }
+
+#endif
+    }
+
+    crc32c_t crc32c(crc32c_t c, size_t n, uint8_t const p[])
+    {
+        static crc32c_fn* const fn = crc32c_select();
+        return fn(c, n, p);
+    }
+}
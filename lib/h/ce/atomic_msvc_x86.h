@@ -174,6 +174,12 @@ namespace ce
             };
             template<> union atomic<void> { };
 
+            inline void atomic_thread_fence() noexcept
+            {
+                _ReadWriteBarrier();
+                _mm_mfence();
+                _ReadWriteBarrier();
+            }
 
             template<class T> inline T atomic_load(atomic<T> const& a) noexcept
             {
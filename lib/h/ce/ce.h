@@ -43,12 +43,18 @@ namespace ce
         using int32_t = decltype(2147483647);
         using int64_t = decltype(9223372036854775807);
 
+        template<class T>
+        T&& move(T& a)
+        {
+            return static_cast<T&&>(a);
+        }
+
         template<class T>
         void swap(T& a, T& b)
         {
-            T c(a);
-            a = b;
-            b = c;
+            T c(move(a));
+            a = move(b);
+            b = move(c);
         }
     }
 
@@ -66,6 +72,7 @@ namespace ce
         extern "C" void* __cdecl memset(void* a, int, size_t);
         extern "C" size_t __cdecl strlen(const char*);
         extern "C" unsigned int __cdecl _rotl(unsigned int, int);
+        extern "C" void _mm_prefetch(char const*, int);
 #pragma intrinsic(memcpy)
 #pragma intrinsic(memset)
 #pragma intrinsic(strlen)
@@ -78,6 +85,17 @@ namespace ce
             return (x << (i & 31)) | (x >> (32 - (i & 31)));
         }
 
+        // count trailing zeros of x != 0, isolate the lowest bit and look it up with a de bruijn sequence
+        constexpr int ctz64(uint64_t x)
+        {
+            constexpr int8_t index[64]
+            {
+                0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4, 62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+                63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+            };
+            return index[((x & (0 - x)) * 0x03f79d71b4cb0a89) >> 58];
+        }
+
         class new_tag;
     }
 
@@ -155,6 +173,8 @@ inline void* operator new(ce::size_t, ce::detail::new_tag* p) noexcept { return
 #define CE_MEMSET(...) __builtin_memset(__VA_ARGS__)
 #define CE_STRLEN(...) __builtin_strlen(__VA_ARGS__)
 #define CE_ROTL32(...) __builtin_rotateleft32(__VA_ARGS__)
+#define CE_PREFETCH(...) __builtin_prefetch(__VA_ARGS__)
+#define CE_CTZ64(...) __builtin_ctzll(__VA_ARGS__)
 #define CE_NOINLINE __attribute__((noinline))
 
 #elif defined(_MSC_VER)
@@ -169,6 +189,12 @@ inline void* operator new(ce::size_t, ce::detail::new_tag* p) noexcept { return
 #define CE_MEMSET(...) ce::detail::memset(__VA_ARGS__)
 #define CE_STRLEN(...) ce::detail::strlen(__VA_ARGS__)
 #define CE_ROTL32(...) ce::detail::_rotl(__VA_ARGS__)
+#if CE_CPU_X86
+#define CE_PREFETCH(...) ce::detail::_mm_prefetch(reinterpret_cast<char const*>(__VA_ARGS__), 1)
+#else
+#define CE_PREFETCH(...) void(0)
+#endif
+#define CE_CTZ64(...) ce::detail::ctz64(__VA_ARGS__)
 #define CE_NOINLINE __declspec(noinline)
 
 #elif defined(__GNUC__)
@@ -184,6 +210,8 @@ inline void* operator new(ce::size_t, ce::detail::new_tag* p) noexcept { return
 #define CE_MEMSET(...) __builtin_memset(__VA_ARGS__)
 #define CE_STRLEN(...) __builtin_strlen(__VA_ARGS__)
 #define CE_ROTL32(...) ce::detail::rotl32(__VA_ARGS__)
+#define CE_PREFETCH(...) __builtin_prefetch(__VA_ARGS__)
+#define CE_CTZ64(...) __builtin_ctzll(__VA_ARGS__)
 #define CE_NOINLINE __attribute__((noinline))
 
 #endif
@@ -524,6 +552,9 @@ namespace ce
         return ~v;
     }
 
+    // runtime crc32c, same result as crc32(c, n, p) but uses the sse4.2 / armv8 crc instructions when the cpu has them
+    crc32c_t crc32c(crc32c_t c, size_t n, uint8_t const p[]);
+
     //--------
 
     namespace hash
@@ -1242,6 +1273,11 @@ namespace ce
         }
 
         uint8_t* virtual_alloc(size_t size);
+
+        // reserve address space without memory, commit page aligned parts of it as needed
+        uint8_t* virtual_reserve(size_t size);
+        bool virtual_commit(uint8_t* data, size_t size);
+        bool virtual_free(uint8_t* data, size_t size);
     }
 
 #define CE_CONSTRUCT_AT(...) new (reinterpret_cast<ce::detail::new_tag*>(__VA_ARGS__))
@@ -1416,23 +1452,28 @@ namespace ce
 
     template<class T, size_t N> using list = bulk<N, T>;
 
-    template<class T> void heap_raise(T data[], T item, size_t n)
+    template<class T, class C> void heap_raise(T data[], T item, size_t n, C less)
     {
         while (n > 0)
         {
             auto p = (n - 1) / 2;
 
-            if (item < data[p])
-                data[n] = data[p];
+            if (less(item, data[p]))
+                data[n] = move(data[p]);
             else
                 break;
 
             n = p;
         }
-        data[n] = item;
+        data[n] = move(item);
     }
 
-    template<class T> void heap_lower(size_t size, T data[], T item, size_t n)
+    template<class T> void heap_raise(T data[], T item, size_t n)
+    {
+        heap_raise(data, move(item), n, [](T const& a, T const& b) { return a < b; });
+    }
+
+    template<class T, class C> void heap_lower(size_t size, T data[], T item, size_t n, C less)
     {
         for (;;)
         {
@@ -1440,22 +1481,37 @@ namespace ce
             if (p >= size)
                 break;
 
-            if (p + 1 < size && data[p + 1] < data[p])
+            if (p + 1 < size && less(data[p + 1], data[p]))
                 ++p;
 
-            if (item < data[p])
+            if (less(item, data[p]))
                 break;
 
-            data[n] = data[p];
+            data[n] = move(data[p]);
             n = p;
         }
-        data[n] = item;
+        data[n] = move(item);
     }
 
-    template<size_t N, class T> struct min_priority_queue
+    template<class T> void heap_lower(size_t size, T data[], T item, size_t n)
+    {
+        heap_lower(size, data, move(item), n, [](T const& a, T const& b) { return a < b; });
+    }
+
+    namespace detail
+    {
+        struct heap_less
+        {
+            template<class T> bool operator()(T const& a, T const& b) const { return a < b; }
+        };
+    }
+
+    // head is the least item by less, operator< unless given
+    template<size_t N, class T, class C = detail::heap_less> struct min_priority_queue
     {
         size_t size;
         T data[N];
+        C less;
 
         T head() const { return data[0]; }
 
@@ -1463,15 +1519,15 @@ namespace ce
 
         bool enqueue(T item)
         {
-            return size < N ? heap_raise(data, item, size++), true : false;
+            return size < N ? heap_raise(data, move(item), size++, less), true : false;
         }
 
         T dequeue()
         {
-            T item = data[0];
+            T item = move(data[0]);
 
             if (--size > 0)
-                heap_lower(size, data, data[size], 0);
+                heap_lower(size, data, move(data[size]), 0, less);
 
             return item;
         }
@@ -1525,6 +1581,29 @@ namespace ce
             }
         }
 
+        // the first set bit at or after index, N if there is none, scanning 64 bits at a time
+        size_t find_next(size_t index) const
+        {
+            constexpr size_t bytes = (N + 7) >> 3;
+
+            auto mask = ~uint64_t(0) << (index % 64);
+            for (size_t w = index / 64; w * 64 < N; ++w, mask = ~uint64_t(0))
+            {
+                // assembled byte by byte so bit i of the word is bit i of the set on any endianness,
+                // compilers turn this into a single load on little endian targets
+                uint64_t word = 0;
+                for (size_t b = w * 8, end = b + 8 < bytes ? b + 8 : bytes; b < end; ++b)
+                    word |= uint64_t(data[b]) << (b % 8 * 8);
+
+                if ((word &= mask) != 0)
+                {
+                    auto i = w * 64 + CE_CTZ64(word);
+                    return i < N ? i : N;
+                }
+            }
+            return N;
+        }
+
         constexpr size_t get_size() const { return N; }
     };
 }
@@ -1547,4 +1626,8 @@ CE_STATIC_ASSERT(ce::crc32c("The quick brown fox jumps over the lazy dog") == 0x
 CE_STATIC_ASSERT(ce::crc32c("123456789") == 0xe3069283);
 
 CE_STATIC_ASSERT(ce::hash::fnv1a("Mallori, Jimmy, Sydney") == 0xaaad3b41);
+
+CE_STATIC_ASSERT(ce::detail::ctz64(1) == 0);
+CE_STATIC_ASSERT(ce::detail::ctz64(0x8000000000000000) == 63);
+CE_STATIC_ASSERT(ce::detail::ctz64(0x0000000000a00000) == 21);
 #endif
@@ -24,6 +24,8 @@ SOFTWARE.
 */
 
 #include "ce.h"
+#include "atomic.h"
+#include "mutex.h"
 
 namespace ce
 {
@@ -38,30 +40,193 @@ namespace ce
         size_t size;
         data_t data[N];
 
-        size_t heap; // this many names form a binary heap
+        size_t heap; // names[1, heap) are a binary search tree in eytzinger (bfs) order, names[heap, size) are unordered
         name_t names[N];
 
-        void optimize() { } //TODO jea sort into binary heap
+        size_t erased; // this many slots are tombstones, they keep their name so the search tree stays ordered
+        size_t buried; // this many of the tombstones are inside the search tree, only optimize reclaims those
+        size_t sweep; // the next slot compact will examine
+        bitset<N> tombs;
 
-        ptr_t find(name_t n) const
+        // sort all live names (and their data) into an eytzinger binary search tree, dropping any tombstones
+        // names bound after this are found with a linear scan until the next optimize
+        // this moves data so any ptr_t's are invalidated, remap[old] is set to the new ptr_t of each entry (nil if erased)
+        // works in place, remap (if given) is the only other storage and tombs is reused to mark visited slots
+        void optimize(ptr_t remap[N])
         {
-            // heap scan
-            for (size_t i = 1; i < heap; i += i + (names[i] >= n))
-                if (names[i] == n)
-                    return ptr_t(i);
+            size_t n = size - !!size;
+            CE_ASSERT(erased <= n);
+
+            // remap[slot] tracks the original slot of whatever is in slot until it is inverted at the end
+            if (remap)
+                for (size_t i = 0; i <= n; ++i)
+                    remap[i] = ptr_t(i);
+
+            // move live entries to the front, trading places with live entries from the back
+            size_t live = n - erased;
+            for (size_t i = 1, j = n; i <= live; ++i)
+            {
+                if (tombs[i])
+                {
+                    while (tombs[j])
+                        --j;
+                    exchange(i, j--, remap);
+                }
+            }
+
+            // heap sort [1, live] by name, 1 based so the children of k are 2k and 2k + 1
+            for (size_t k = live / 2; k > 0; --k)
+                sift(k, live, remap);
+            for (size_t m = live; m > 1; --m)
+            {
+                exchange(1, m, remap);
+                sift(1, m - 1, remap);
+            }
+
+            // node k of the tree takes the sorted entry at its in order rank, follow the cycles of that permutation
+            tombs.reset();
+            for (size_t i = 1; i <= live; ++i)
+            {
+                if (tombs[i])
+                    continue;
+
+                tombs.set(i);
+                for (size_t j = i, k = 1 + rank(i, live); k != i; j = k, k = 1 + rank(k, live))
+                {
+                    exchange(j, k, remap);
+                    tombs.set(k);
+                }
+            }
+
+            // remap[new] = old so far, invert it in place marking each slot as it is written
+            if (remap)
+            {
+                tombs.reset();
+                for (size_t i = 1; i <= n; ++i)
+                {
+                    for (size_t j = i, k = size_t(remap[i]); !tombs[k];)
+                    {
+                        size_t next = size_t(remap[k]);
+                        remap[k] = ptr_t(j);
+                        tombs.set(k);
+                        j = k;
+                        k = next;
+                    }
+                }
+
+                for (size_t i = 1; i <= n; ++i)
+                    if (size_t(remap[i]) > live)
+                        remap[i] = ptr_t::nil;
+            }
+
+            size = live + !!live;
+            heap = size;
+            erased = 0;
+            buried = 0;
+            sweep = 0;
+            tombs.reset();
+        }
+
+        void optimize()
+        {
+            optimize(nullptr);
+        }
+
+        // the slot bound to n even if it has been erased
+        size_t locate(name_t n) const
+        {
+            // eytzinger search, branchless descent remembering the last node not less than n
+            // prefetch the 16 nodes 4 levels down (a cache line of 32 bit names)
+            size_t j = 0;
+            for (size_t i = 1; i < heap;)
+            {
+                if (i * 16 < heap)
+                    CE_PREFETCH(&names[i * 16]);
+
+                bool less = names[i] < n;
+                j = less ? j : i;
+                i = i + i + less;
+            }
+
+            if (j != 0 && names[j] == n)
+                return j;
 
-            // linear scan
-            for (size_t i = heap; i < size; ++i)
+            return scan(n);
+        }
+
+        // linear scan of the names bound since the last optimize
+        size_t scan(name_t n) const
+        {
+            for (size_t i = heap + !heap; i < size; ++i)
                 if (names[i] == n)
-                    return ptr_t(i);
+                    return i;
 
-            return ptr_t::nil;
+            return 0;
+        }
+
+        ptr_t find(name_t n) const
+        {
+            auto i = locate(n);
+            return ptr_t(tombs[i] ? 0 : i);
+        }
+
+        // find a batch of names, descending the search tree for a group of names in lock step
+        // prefetching each name's next node so the cache misses of the group overlap instead of forming one long chain
+        void find_n(size_t n, name_t const keys[], ptr_t out[]) const
+        {
+            constexpr size_t M = 16;
+
+            for (size_t b = 0; b < n; b += M)
+            {
+                size_t m = n - b < M ? n - b : M;
+
+                size_t node[M];
+                size_t last[M];
+                for (size_t k = 0; k < m; ++k)
+                    node[k] = 1, last[k] = 0;
+
+                // descents differ in length by at most one step
+                for (bool more = heap > 1; more;)
+                {
+                    more = false;
+                    for (size_t k = 0; k < m; ++k)
+                    {
+                        auto i = node[k];
+                        if (i < heap)
+                        {
+                            bool less = names[i] < keys[b + k];
+                            last[k] = less ? last[k] : i;
+                            node[k] = i = i + i + less;
+
+                            if (i < heap)
+                                CE_PREFETCH(&names[i]), more = true;
+                        }
+                    }
+                }
+
+                for (size_t k = 0; k < m; ++k)
+                {
+                    auto j = last[k];
+                    if (j == 0 || names[j] != keys[b + k])
+                        j = scan(keys[b + k]);
+
+                    out[b + k] = ptr_t(tombs[j] ? 0 : j);
+                }
+            }
         }
 
         template<class...Ts>
         ptr_t bind(name_t n, Ts&&...ts)
         {
-            auto i = size_t(find(n));
+            // rebinding an erased name revives its tombstone
+            auto i = locate(n);
+            if (i != 0 && tombs[i])
+            {
+                tombs.reset(i);
+                --erased;
+                buried -= i < heap;
+            }
+
             if (i == 0)
             {
                 if (size >= N)
@@ -81,6 +246,87 @@ namespace ce
             return ptr_t(i);
         }
 
+        // O(1) erase, the slot becomes a tombstone until it is rebound, compacted or optimized away
+        // erase itself never moves other entries, but compact and optimize do and report where they went
+        bool erase(ptr_t p)
+        {
+            auto i = size_t(p);
+            if (i == 0 || i >= size || tombs[i])
+                return false;
+
+            tombs.set(i);
+            ++erased;
+            buried += i < heap;
+
+            // release whatever the data holds now rather than when the slot is reused
+            data[i].~data_t();
+            new (reinterpret_cast<detail::new_tag*>(&data[i])) data_t{ };
+
+            return true;
+        }
+
+        bool erase(name_t n) { return erase(find(n)); }
+
+        struct move_t
+        {
+            ptr_t from;
+            ptr_t to;
+        };
+
+        // reclaim tombstones past the search tree examining at most `budget` slots so the work can be spread over frames
+        // a tombstone is filled by moving the last entry into it, invalidating the moved entry's ptr_t
+        // each move is reported in moves[0, moved) (room for `budget` of them, or null) so held ptr_t's can be updated
+        // tombstones inside the tree keep their names so the tree stays ordered and are left for optimize
+        // returns the number of tombstones compact can still reclaim
+        size_t compact(size_t budget, move_t moves[], size_t& moved)
+        {
+            moved = 0;
+
+            for (; erased > buried && budget > 0; --budget)
+            {
+                auto last = size - 1;
+                if (!tombs[last])
+                {
+                    auto first = heap + !heap;
+                    if (sweep < first || sweep >= last)
+                        sweep = first;
+
+                    auto i = sweep++;
+                    if (!tombs[i])
+                        continue;
+
+                    names[i] = names[last];
+                    data[i] = static_cast<data_t&&>(data[last]);
+                    tombs.reset(i);
+                    tombs.set(last);
+
+                    data[last].~data_t();
+                    new (reinterpret_cast<detail::new_tag*>(&data[last])) data_t{ };
+
+                    if (moves)
+                        moves[moved] = { ptr_t(last), ptr_t(i) };
+                    ++moved;
+                }
+
+                // the last slot is now a tombstone, drop it
+                tombs.reset(last);
+                --erased;
+                buried -= last < heap;
+                size = last > 1 ? last : 0;
+                if (heap > size)
+                    heap = size;
+            }
+
+            return erased - buried;
+        }
+
+        // for callers that hold no ptr_t's across a compact
+        size_t compact(size_t budget)
+        {
+            size_t moved;
+            return compact(budget, nullptr, moved);
+        }
+
         data_t const& operator[](ptr_t p) const
         {
             auto i = size_t(p);
@@ -108,5 +354,412 @@ namespace ce
             CE_ASSERT(i != 0 && i < size);
             return data[i];
         }
+
+        void exchange(size_t i, size_t j, ptr_t remap[])
+        {
+            swap(names[i], names[j]);
+            swap(data[i], data[j]);
+            if (remap)
+                swap(remap[i], remap[j]);
+        }
+
+        void sift(size_t k, size_t n, ptr_t remap[])
+        {
+            for (size_t c = k + k; c <= n; k = c, c = k + k)
+            {
+                c += c < n && names[c] < names[c + 1];
+                if (!(names[k] < names[c]))
+                    break;
+                exchange(k, c, remap);
+            }
+        }
+
+        // number of nodes in the subtree at node k of an n node eytzinger tree
+        static size_t subtree(size_t k, size_t n)
+        {
+            size_t count = 0;
+            for (size_t lo = k, hi = k; lo <= n; lo = lo + lo, hi = hi + hi + 1)
+                count += (hi < n ? hi : n) - lo + 1;
+            return count;
+        }
+
+        // in order rank of node k, its left subtree plus, for each ancestor it is right of, that ancestor and its left subtree
+        static size_t rank(size_t k, size_t n)
+        {
+            size_t r = subtree(k + k, n);
+            for (; k > 1; k /= 2)
+                if (k % 2 != 0)
+                    r += subtree(k - 1, n) + 1;
+            return r;
+        }
+    };
+
+    // dictionary shared between many reader threads and any number of writer threads
+    // names are written once, before the slot is published by storing size, so find is wait-free
+    // find descends an eytzinger search tree over the names present at the last optimize, like dictionary,
+    // and scans the names bound since then, a ptr_t stays valid until the next optimize as nothing is erased
+    // data is guarded by a sequence lock per slot so rebinding a name doesn't block readers
+    // writers are serialized by a mutex
+    template<int N, class T, class K> struct concurrent_dictionary
+    {
+        using data_t = T;
+        using index_t = unsigned;
+        enum class ptr_t : index_t { nil };
+
+        using name_t = K;
+
+        CE_STATIC_ASSERT(__is_trivially_copyable(T), "readers copy data that may be concurrently rebound");
+
+        atomic<index_t> size;
+        atomic<index_t> heap; // names[1, heap) are a binary search tree in eytzinger (bfs) order, names[heap, size) are unordered
+        name_t names[N];
+
+        atomic<uint32_t> versions[N]; // odd while data is being written
+        data_t data[N];
+
+        thread_mutex writer;
+
+        void reset()
+        {
+            atomic_store(size, 0);
+            atomic_store(heap, 0);
+            for (auto& v : versions)
+                atomic_store(v, 0);
+            construct_mutex(writer);
+        }
+
+        void destroy()
+        {
+            destroy_mutex(writer);
+        }
+
+        // sort the names (and their data) into an eytzinger binary search tree so find descends it instead of scanning
+        // this moves data so any ptr_t's are invalidated, and readers must not be running, e.g. call it once loading is done
+        void optimize()
+        {
+            acquire_mutex(writer);
+
+            index_t end = atomic_load(size);
+            size_t n = end - !!end;
+
+            // heap sort [1, n] by name, then node k of the tree takes the sorted entry at its in order rank
+            for (size_t k = n / 2; k > 0; --k)
+                sift(k, n);
+            for (size_t m = n; m > 1; --m)
+            {
+                exchange(1, m);
+                sift(1, m - 1);
+            }
+
+            bitset<N> placed;
+            placed.reset();
+            for (size_t i = 1; i <= n; ++i)
+            {
+                if (placed[i])
+                    continue;
+
+                placed.set(i);
+                for (size_t j = i, k = 1 + dictionary<N, T, K>::rank(i, n); k != i; j = k, k = 1 + dictionary<N, T, K>::rank(k, n))
+                {
+                    exchange(j, k);
+                    placed.set(k);
+                }
+            }
+
+            atomic_store(heap, end);
+
+            release_mutex(writer);
+        }
+
+        ptr_t find(name_t n) const
+        {
+            // eytzinger search, the tree is only rebuilt while there are no readers so its names never change under us
+            index_t top = atomic_load(heap);
+            index_t j = 0;
+            for (index_t i = 1; i < top;)
+            {
+                bool less = names[i] < n;
+                j = less ? j : i;
+                i = i + i + less;
+            }
+
+            if (j != 0 && names[j] == n)
+                return ptr_t(j);
+
+            // linear scan of the names bound since the last optimize
+            auto end = atomic_load(size);
+            for (index_t i = top + !top; i < end; ++i)
+                if (names[i] == n)
+                    return ptr_t(i);
+
+            return ptr_t::nil;
+        }
+
+        template<class...Ts>
+        ptr_t bind(name_t n, Ts&&...ts)
+        {
+            acquire_mutex(writer);
+
+            auto i = index_t(find(n));
+            auto end = atomic_load(size);
+            if (i == 0 && end < N)
+            {
+                i = end + !end; // add 1 if size == 0 so we don't allocate 0
+                names[i] = n;
+            }
+
+            if (i != 0)
+            {
+                atomic_fetch_add(versions[i], 1);
+                data[i] = data_t{ static_cast<Ts>(ts)... };
+                atomic_fetch_add(versions[i], 1);
+
+                // publish a new name only after its data is written
+                if (i >= end)
+                    atomic_store(size, i + 1);
+            }
+
+            release_mutex(writer);
+
+            return ptr_t(i);
+        }
+
+        // copy out the data bound to p, retrying only while a writer is rebinding this slot
+        bool read(ptr_t p, data_t& out) const
+        {
+            auto i = size_t(p);
+            if (i == 0 || i >= atomic_load(size))
+                return false;
+
+            for (;;)
+            {
+                auto v = atomic_load(versions[i]);
+                if (v % 2 == 0)
+                {
+                    out = data[i];
+                    atomic_thread_fence();
+                    if (atomic_load(versions[i]) == v)
+                        return true;
+                }
+            }
+        }
+
+        bool read(name_t n, data_t& out) const { return read(find(n), out); }
+
+        void exchange(size_t i, size_t j)
+        {
+            swap(names[i], names[j]);
+            swap(data[i], data[j]);
+        }
+
+        void sift(size_t k, size_t n)
+        {
+            for (size_t c = k + k; c <= n; k = c, c = k + k)
+            {
+                c += c < n && names[c] < names[c + 1];
+                if (!(names[k] < names[c]))
+                    break;
+                exchange(k, c);
+            }
+        }
+    };
+
+    namespace detail
+    {
+        // hash and displace (chd), keys are hashed into buckets of about 4, then largest bucket first each bucket
+        // searches for a displacement that puts all of its keys in free slots of a table 1.25x the key count
+        // a key's slot is slot(key, seed, displace[bucket(key, seed)])
+        template<class K, K...Ns> struct perfect_hash
+        {
+            static constexpr size_t count = sizeof...(Ns);
+            static constexpr size_t buckets = (count + 3) / 4;
+            static constexpr size_t capacity = count + count / 4 + 1;
+            static constexpr uint32_t max_displace = 1 << 14;
+
+            CE_STATIC_ASSERT(count > 0);
+
+            static constexpr uint64_t mix(uint64_t x)
+            {
+                x = (x ^ (x >> 33)) * 0xff51afd7ed558ccd;
+                x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53;
+                return x ^ (x >> 33);
+            }
+
+            // 32 bits of hash times the range, so no divide
+            static constexpr size_t bucket(K n, uint64_t seed) { return size_t((mix(uint64_t(n) ^ seed) >> 32) * buckets >> 32); }
+            static constexpr size_t slot(K n, uint64_t seed, uint32_t d) { return size_t((mix(uint64_t(n) + seed + d * 0x9e3779b97f4a7c15) & 0xffffffff) * capacity >> 32); }
+
+            struct result
+            {
+                bool duplicate;
+                bool found;
+                uint64_t seed;
+                uint32_t displace[buckets];
+            };
+
+            static constexpr result search()
+            {
+                K const keys[count]{ Ns... };
+                result r{ };
+
+                uint64_t state = 0;
+                for (int attempt = 0; attempt < 8; ++attempt)
+                {
+                    uint64_t seed = mix(state += 0x9e3779b97f4a7c15);
+
+                    // group the keys by bucket
+                    size_t start[buckets + 1]{ };
+                    for (auto n : keys)
+                        ++start[bucket(n, seed) + 1];
+                    for (size_t b = 0; b < buckets; ++b)
+                        start[b + 1] += start[b];
+
+                    size_t fill[buckets]{ };
+                    K grouped[count]{ };
+                    for (auto n : keys)
+                    {
+                        auto b = bucket(n, seed);
+                        grouped[start[b] + fill[b]++] = n;
+                    }
+
+                    // equal keys always share a bucket
+                    for (size_t b = 0; b < buckets; ++b)
+                        for (size_t i = start[b]; i < start[b + 1]; ++i)
+                            for (size_t j = start[b]; j < i; ++j)
+                            {
+                                if (grouped[i] == grouped[j])
+                                {
+                                    r.duplicate = true;
+                                    return r;
+                                }
+                            }
+
+                    // largest buckets first, a counting sort on size
+                    size_t sizes[count + 2]{ };
+                    for (size_t b = 0; b < buckets; ++b)
+                        ++sizes[count - (start[b + 1] - start[b]) + 1];
+                    for (size_t i = 0; i <= count; ++i)
+                        sizes[i + 1] += sizes[i];
+
+                    size_t order[buckets]{ };
+                    for (size_t b = 0; b < buckets; ++b)
+                        order[sizes[count - (start[b + 1] - start[b])]++] = b;
+
+                    uint64_t used[(capacity + 63) / 64]{ };
+                    bool placed = true;
+                    for (size_t k = 0; placed && k < buckets; ++k)
+                    {
+                        auto b = order[k];
+                        if (start[b] == start[b + 1])
+                            break;
+
+                        placed = false;
+                        for (uint32_t d = 0; !placed && d < max_displace; ++d)
+                        {
+                            // claim slots for the bucket's keys, giving them back on the first collision
+                            size_t i = start[b];
+                            for (; i < start[b + 1]; ++i)
+                            {
+                                auto h = slot(grouped[i], seed, d);
+                                if (used[h / 64] >> (h % 64) & 1)
+                                    break;
+                                used[h / 64] |= uint64_t(1) << (h % 64);
+                            }
+
+                            placed = i == start[b + 1];
+                            if (placed)
+                                r.displace[b] = d;
+                            else
+                            {
+                                for (size_t j = start[b]; j < i; ++j)
+                                {
+                                    auto h = slot(grouped[j], seed, d);
+                                    used[h / 64] &= ~(uint64_t(1) << (h % 64));
+                                }
+                            }
+                        }
+                    }
+
+                    if (placed)
+                    {
+                        r.found = true;
+                        r.seed = seed;
+                        return r;
+                    }
+
+                    for (auto& d : r.displace)
+                        d = 0;
+                }
+
+                return r;
+            }
+
+            static constexpr result found = search();
+            CE_STATIC_ASSERT(!found.duplicate, "perfect hash names contain duplicate keys");
+            CE_STATIC_ASSERT(found.duplicate || found.found, "perfect hash search exhausted every seed and displacement");
+
+            static constexpr uint64_t seed = found.seed;
+
+            static constexpr size_t find(K n) { return slot(n, seed, found.displace[bucket(n, seed)]); }
+        };
+    }
+
+    // compile time perfect hash table for a fixed set of names, e.g. fnv1a hashes of config keys or enum names
+    // find is two hashes, a displacement lookup and one compare against constexpr tables
+    template<class T, class Names> struct perfect_dictionary;
+
+    template<class T, class K, K...Ns> struct perfect_dictionary<T, items<K, Ns...>>
+    {
+        using data_t = T;
+        using index_t = unsigned;
+        enum class ptr_t : index_t { nil };
+
+        using name_t = K;
+
+        using hash_t = detail::perfect_hash<K, Ns...>;
+
+        // slot 0 is nil so slots are [1, capacity]
+        static constexpr size_t capacity = hash_t::capacity;
+
+        struct table_t { name_t names[capacity + 1]; };
+
+        static constexpr table_t make_table()
+        {
+            // empty slots get a key that hashes elsewhere so they never match
+            table_t t{ };
+            K const keys[]{ Ns... };
+            for (auto& n : t.names)
+                n = keys[0];
+            for (auto n : keys)
+                t.names[1 + hash_t::find(n)] = n;
+            return t;
+        }
+
+        static constexpr table_t table = make_table();
+
+        data_t data[capacity + 1];
+
+        static constexpr ptr_t find(name_t n)
+        {
+            auto i = 1 + hash_t::find(n);
+            return ptr_t(table.names[i] == n ? i : 0);
+        }
+
+        data_t const& operator[](ptr_t p) const
+        {
+            auto i = size_t(p);
+            CE_ASSERT(i != 0 && i <= capacity);
+            return data[i];
+        }
+
+        data_t& operator[](ptr_t p)
+        {
+            auto i = size_t(p);
+            CE_ASSERT(i != 0 && i <= capacity);
+            return data[i];
+        }
+
+        data_t const& operator[](name_t n) const { return (*this)[find(n)]; }
+        data_t& operator[](name_t n) { return (*this)[find(n)]; }
     };
 }
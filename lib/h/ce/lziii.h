@@ -25,6 +25,9 @@ SOFTWARE.
 
 #include "ce.h"
 
+// source type for lziii::encoder from a string literal, the terminating 0 is not included
+#define CE_LZIII_TEXT(NAME, TEXT) struct NAME { ce::size_t size = sizeof(TEXT) - 1; char const* data = TEXT; }
+
 namespace ce
 {
     namespace lziii
@@ -90,6 +93,483 @@ namespace ce
             }
         }
 
+        // worst case encoded size, every byte a literal plus a control byte per 8
+        constexpr size_t encode_bound(size_t size)
+        {
+            return size + (size + 7) / 8;
+        }
+
+        constexpr size_t window = 4096;
+        constexpr size_t min_span = 3;
+        constexpr size_t max_span = 18;
+
+        // encodes src (bytes or chars) into dst (at least encode_bound(src_size) bytes), returns the encoded size
+        // matches are found with hash chains over the last 4096 positions, effort 0 (fastest) to 4 (smallest)
+        // sets how many chain links are followed, 3 and up also try a lazy match one byte later
+        template<class B> constexpr size_t encode(size_t src_size, B const src[], uint8_t dst[], size_t effort = 2)
+        {
+            constexpr size_t depths[]{ 1, 4, 16, 64, 256 };
+            size_t depth = depths[effort < 4 ? effort : 4];
+            bool lazy = effort >= 3;
+
+            // head[h] and prev[i % window] hold position + 1, 0 ends a chain, h is a 12 bit hash of 3 bytes
+            uint32_t head[4096]{ };
+            uint32_t prev[window]{ };
+
+            // positions with 3 bytes to hash, the 3 bytes are rolled along in key so each byte is read once
+            // and everything is inline, calls and lambda captures cost the constexpr step limit as much as the work
+            size_t hashable = src_size < min_span ? 0 : src_size - min_span + 1;
+            size_t inserted = 0;
+            uint32_t key = hashable ? uint32_t(uint8_t(src[0]) << 8 | uint8_t(src[1])) : 0;
+
+            size_t o = 0;
+            size_t control = 0;
+            unsigned bit = 8;
+
+            for (size_t i = 0; i < src_size;)
+            {
+                // longest span at i, distance d, then if lazy at i + 1 where a longer span is worth a literal
+                size_t n = 0;
+                size_t d = 0;
+                for (size_t at = i, last = i + lazy; at <= last && at < hashable; ++at)
+                {
+                    // hash every position before at into the chains
+                    for (; inserted < at; ++inserted)
+                    {
+                        key = (key << 8 | uint8_t(src[inserted + 2])) & 0xffffff;
+                        size_t h = key * 2654435761u >> 20;
+                        prev[inserted % window] = head[h];
+                        head[h] = uint32_t(inserted + 1);
+                    }
+
+                    size_t best = 0;
+                    size_t distance = 0;
+                    size_t limit = src_size - at < max_span ? src_size - at : max_span;
+                    size_t j = head[((key << 8 | uint8_t(src[at + 2])) & 0xffffff) * 2654435761u >> 20];
+                    for (size_t steps = 0; j != 0 && steps < depth; ++steps)
+                    {
+                        size_t k = j - 1;
+                        if (at - k > window)
+                            break;
+
+                        // a candidate that differs at best can't be longer
+                        if (src[k + best] == src[at + best])
+                        {
+                            size_t m = 0;
+                            while (m < limit && src[k + m] == src[at + m])
+                                ++m;
+
+                            if (m > best)
+                            {
+                                best = m;
+                                distance = at - k;
+                                if (m == limit)
+                                    break;
+                            }
+                        }
+                        j = prev[k % window];
+                    }
+
+                    if (at == i)
+                    {
+                        n = best;
+                        d = distance;
+                        if (n < min_span || n == max_span)
+                            break;
+                    }
+                    else if (best > n)
+                        n = 0;
+                }
+
+                // only start a control byte when there is something to follow it
+                if (bit == 8)
+                {
+                    control = o++;
+                    dst[control] = 0;
+                    bit = 0;
+                }
+
+                if (n >= min_span)
+                {
+                    size_t q = window - d;
+                    dst[o++] = uint8_t(q);
+                    dst[o++] = uint8_t((n - min_span) * 16 + q / 256);
+                    i += n;
+                }
+                else
+                {
+                    dst[control] = uint8_t(dst[control] | 1u << bit);
+                    dst[o++] = uint8_t(src[i++]);
+                }
+                ++bit;
+            }
+            return o;
+        }
+
+        constexpr size_t decode_error = ~size_t(0);
+
+        // runtime decoder for untrusted input, decodes all of src into dst and returns the decoded size,
+        // or decode_error if src is truncated, a span reaches before the start, or dst_capacity is too small
+        inline size_t decode_checked(size_t src_size, uint8_t const src[], size_t dst_capacity, uint8_t dst[])
+        {
+            size_t s = 0;
+            size_t o = 0;
+
+            // a control byte and 8 items is at most 17 source bytes and 8 * 18 decoded bytes, plus up to
+            // 14 bytes of over copy, while that much is left on both sides a group needs no bounds checks
+            while (src_size - s > 17 && dst_capacity - o >= 8 * max_span + 16)
+            {
+                unsigned c = src[s++] | 0x100;
+                for (; c != 1; c /= 2)
+                {
+                    if (c % 2 != 0)
+                    {
+                        dst[o++] = src[s++];
+                        continue;
+                    }
+
+                    size_t p = src[s++];
+                    size_t q = src[s++];
+                    size_t d = window - (q % 16 * 256 + p);
+                    size_t n = q / 16 + min_span;
+                    if (d > o)
+                        return decode_error;
+
+                    uint8_t* to = dst + o;
+                    uint8_t const* from = to - d;
+                    o += n;
+
+                    if (d >= 16)
+                    {
+                        // 18 bytes at most, two 16 byte copies that never read what they write
+                        CE_MEMCPY(to, from, 16);
+                        if (n > 16)
+                            CE_MEMCPY(to + 16, from + 16, 16);
+                    }
+                    else if (d >= 8)
+                    {
+                        // each 8 byte copy only reads bytes already written
+                        CE_MEMCPY(to, from, 8);
+                        CE_MEMCPY(to + 8, from + 8, 8);
+                        if (n > 16)
+                            CE_MEMCPY(to + 16, from + 16, 8);
+                    }
+                    else
+                    {
+                        // short distances repeat a pattern, lay down 8 bytes of it one at a time, then
+                        // continue 8 at a time from a whole number of periods back (at least 8)
+                        constexpr uint8_t periods[]{ 0, 8, 8, 9, 8, 10, 12, 14 };
+                        for (size_t i = 0; i < 8; ++i)
+                            to[i] = from[i];
+                        from = to + 8 - periods[d];
+                        CE_MEMCPY(to + 8, from, 8);
+                        if (n > 16)
+                            CE_MEMCPY(to + 16, from + 8, 8);
+                    }
+                }
+            }
+
+            // the tail, checking every byte
+            for (unsigned c = 1; s < src_size; c /= 2)
+            {
+                if (c == 1)
+                {
+                    c = src[s++] | 0x100;
+                    if (s == src_size)
+                        return decode_error;
+                }
+
+                if (c % 2 != 0)
+                {
+                    if (o == dst_capacity)
+                        return decode_error;
+                    dst[o++] = src[s++];
+                    continue;
+                }
+
+                if (src_size - s < 2)
+                    return decode_error;
+
+                size_t p = src[s++];
+                size_t q = src[s++];
+                size_t d = window - (q % 16 * 256 + p);
+                size_t n = q / 16 + min_span;
+                if (d > o || dst_capacity - o < n)
+                    return decode_error;
+
+                for (size_t e = o + n; o < e; ++o)
+                    dst[o] = dst[o - d];
+            }
+
+            return o;
+        }
+
+        // resumable decoder for a stream that arrives and leaves in pieces, feed() the next piece of
+        // input then drain() until it returns 0, the last 4096 decoded bytes are kept so spans can
+        // reach back into output the caller has already reused
+        struct stream_decoder
+        {
+            uint8_t history[window];
+            size_t total;       // bytes decoded so far
+            unsigned control;   // control bits left with a stop bit above them, 1 when the next byte is a control byte
+            size_t low;         // first byte of a span split across two feeds
+            bool split;
+            size_t span_size;   // bytes of the current span still to copy
+            size_t distance;
+            size_t src_size;
+            uint8_t const* src;
+            bool error;
+
+            void reset()
+            {
+                total = 0;
+                control = 1;
+                low = 0;
+                split = false;
+                span_size = 0;
+                distance = 0;
+                src_size = 0;
+                src = nullptr;
+                error = false;
+            }
+
+            // the previous piece must have been drained
+            void feed(size_t size, uint8_t const data[])
+            {
+                CE_ASSERT(src_size == 0);
+                src_size = size;
+                src = data;
+            }
+
+            // decodes up to size bytes into dst, returns how many, 0 once the input is used up (or on error)
+            size_t drain(size_t size, uint8_t dst[])
+            {
+                size_t o = 0;
+                while (o < size && !error)
+                {
+                    if (span_size > 0)
+                    {
+                        uint8_t b = history[(total - distance) % window];
+                        history[total++ % window] = b;
+                        dst[o++] = b;
+                        --span_size;
+                        continue;
+                    }
+
+                    if (src_size == 0)
+                        break;
+
+                    uint8_t b = *src++;
+                    --src_size;
+
+                    if (control == 1)
+                    {
+                        control = b | 0x100u;
+                        continue;
+                    }
+
+                    if (control % 2 != 0)
+                    {
+                        history[total++ % window] = b;
+                        dst[o++] = b;
+                        control /= 2;
+                        continue;
+                    }
+
+                    if (!split)
+                    {
+                        low = b;
+                        split = true;
+                        continue;
+                    }
+
+                    split = false;
+                    distance = window - (b % 16 * 256 + low);
+                    span_size = b / 16 + min_span;
+                    control /= 2;
+
+                    if (distance > total)
+                    {
+                        error = true;
+                        span_size = 0;
+                    }
+                }
+                return o;
+            }
+
+            // true when everything fed so far decoded to the end of a well formed stream
+            bool complete() const
+            {
+                return !error && src_size == 0 && span_size == 0 && !split && control < 0x100;
+            }
+        };
+
+        // framed container of independently encoded blocks so a large buffer can be decoded by several
+        // threads, or a single block decoded for random access
+        // [16]u8 : header
+        //      u32 magic "lz3f", u32 block size, u64 decoded size (all little endian)
+        // [20]u8 : index entry per block, block count = (decoded size + block size - 1) / block size
+        //      u64 offset of the encoded block from the start of the frame, u32 encoded size,
+        //      u32 decoded size (the block size for all but the last block), u32 crc32c of the decoded block
+        // encoded blocks
+
+        constexpr uint32_t frame_magic = 0x66337a6c;
+        constexpr size_t frame_header_size = 16;
+        constexpr size_t frame_entry_size = 20;
+        constexpr size_t frame_block_size = 65536;
+
+        namespace detail
+        {
+            inline void frame_put(uint8_t p[], size_t n, uint64_t v)
+            {
+                for (size_t i = 0; i < n; ++i)
+                    p[i] = uint8_t(v >> i * 8);
+            }
+
+            inline uint64_t frame_get(uint8_t const p[], size_t n)
+            {
+                uint64_t v = 0;
+                for (size_t i = 0; i < n; ++i)
+                    v |= uint64_t(p[i]) << i * 8;
+                return v;
+            }
+        }
+
+        constexpr size_t frame_block_count(size_t size, size_t block_size)
+        {
+            return (size + block_size - 1) / block_size;
+        }
+
+        // worst case framed size
+        constexpr size_t frame_bound(size_t size, size_t block_size = frame_block_size)
+        {
+            return frame_header_size + frame_block_count(size, block_size) * (frame_entry_size + 1) + encode_bound(size);
+        }
+
+        // encodes src into dst (at least frame_bound(src_size, block_size) bytes) as a frame, returns the framed size
+        inline size_t frame_encode(size_t src_size, uint8_t const src[], uint8_t dst[], size_t block_size = frame_block_size, size_t effort = 2)
+        {
+            CE_ASSERT(block_size > 0 && block_size <= 0xffffffff);
+
+            size_t count = frame_block_count(src_size, block_size);
+
+            detail::frame_put(dst + 0, 4, frame_magic);
+            detail::frame_put(dst + 4, 4, block_size);
+            detail::frame_put(dst + 8, 8, src_size);
+
+            size_t o = frame_header_size + count * frame_entry_size;
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t n = i + 1 < count ? block_size : src_size - i * block_size;
+                uint8_t const* block = src + i * block_size;
+                size_t m = encode(n, block, dst + o, effort);
+
+                uint8_t* entry = dst + frame_header_size + i * frame_entry_size;
+                detail::frame_put(entry + 0, 8, o);
+                detail::frame_put(entry + 8, 4, m);
+                detail::frame_put(entry + 12, 4, n);
+                detail::frame_put(entry + 16, 4, uint32_t(crc32c(crc32c_t::initial, n, block)));
+                o += m;
+            }
+            return o;
+        }
+
+        struct frame_block
+        {
+            size_t offset;
+            size_t encoded_size;
+            size_t decoded_size;
+            uint32_t crc;
+        };
+
+        // read side of a frame, open() checks the header and index so blocks can then be decoded in any
+        // order from any thread, block i decodes to offset i * block_size of the whole
+        struct frame
+        {
+            size_t size;
+            uint8_t const* data;
+            size_t block_size;
+            size_t block_count;
+            size_t decoded_size;
+
+            void reset()
+            {
+                size = 0;
+                data = nullptr;
+                block_size = 0;
+                block_count = 0;
+                decoded_size = 0;
+            }
+
+            frame_block block(size_t i) const
+            {
+                CE_ASSERT(i < block_count);
+                uint8_t const* entry = data + frame_header_size + i * frame_entry_size;
+                return {
+                    size_t(detail::frame_get(entry + 0, 8)),
+                    size_t(detail::frame_get(entry + 8, 4)),
+                    size_t(detail::frame_get(entry + 12, 4)),
+                    uint32_t(detail::frame_get(entry + 16, 4))
+                };
+            }
+
+            // false if the header or index is malformed, the blocks themselves are checked as they are decoded
+            bool open(size_t src_size, uint8_t const src[])
+            {
+                reset();
+                if (src_size < frame_header_size || detail::frame_get(src, 4) != frame_magic)
+                    return false;
+
+                uint64_t bs = detail::frame_get(src + 4, 4);
+                uint64_t ds = detail::frame_get(src + 8, 8);
+                if (bs == 0 || ds > ~size_t(0) - bs)
+                    return false;
+
+                size_t count = frame_block_count(size_t(ds), size_t(bs));
+                if (count > (src_size - frame_header_size) / frame_entry_size)
+                    return false;
+
+                size = src_size;
+                data = src;
+                block_size = size_t(bs);
+                block_count = count;
+                decoded_size = size_t(ds);
+
+                size_t index_end = frame_header_size + count * frame_entry_size;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    frame_block b = block(i);
+                    size_t n = i + 1 < count ? block_size : decoded_size - i * block_size;
+                    if (b.decoded_size != n || b.offset < index_end || b.offset > src_size || b.encoded_size > src_size - b.offset)
+                    {
+                        reset();
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // decodes block i into dst (at least block(i).decoded_size bytes), returns the decoded size,
+            // or decode_error if the block is corrupt or fails its crc
+            size_t decode_block(size_t i, uint8_t dst[]) const
+            {
+                frame_block b = block(i);
+                size_t n = decode_checked(b.encoded_size, data + b.offset, b.decoded_size, dst);
+                if (n != b.decoded_size || uint32_t(crc32c(crc32c_t::initial, n, dst)) != b.crc)
+                    return decode_error;
+                return n;
+            }
+
+            // decodes every block in order into dst (at least decoded_size bytes)
+            size_t decode(uint8_t dst[]) const
+            {
+                for (size_t i = 0; i < block_count; ++i)
+                    if (decode_block(i, dst + i * block_size) == decode_error)
+                        return decode_error;
+                return decoded_size;
+            }
+        };
+
         template<class T> struct decoder
         {
             static constexpr T source{};
@@ -99,5 +579,40 @@ namespace ce
             constexpr decoder() : data{ } { lziii::decode(size, data, source.data); }
         };
 
+        // T::data encoded once at compile time into a worst case sized buffer, both encoded_size and encoder read it
+        // so the compiler runs the encoder a single time
+        template<class T, size_t E> struct encoding
+        {
+            static constexpr T source{ };
+            size_t size;
+            uint8_t data[encode_bound(source.size)];
+
+            constexpr encoding() : size{ }, data{ } { size = lziii::encode(source.size, source.data, data, E); }
+        };
+
+        template<class T, size_t E> constexpr encoding<T, E> encoded{ };
+
+        // compile time encoding defaults to effort 1, deeper chains cost far more constant evaluation steps
+        // than they save bytes and tables of a few KB would run into the compiler's constexpr step limit
+        template<class T, size_t E = 1> constexpr size_t encoded_size()
+        {
+            return encoded<T, E>.size;
+        }
+
+        // compresses T::data (T::size bytes or chars) at compile time, the result has the same
+        // size and data members decoder<T> reads, so decoder<encoder<T>> round trips
+        template<class T, size_t E = 1> struct encoder
+        {
+            static constexpr T source{ };
+            static constexpr auto size = encoded_size<T, E>();
+            uint8_t data[size];
+
+            constexpr encoder() : data{ }
+            {
+                for (size_t i = 0; i < size; ++i)
+                    data[i] = encoded<T, E>.data[i];
+            }
+        };
+
     }
 }
@@ -0,0 +1,212 @@
+#pragma once
+/*
+MIT License
+
+Copyright(c) 2021 James Edward Anhalt III - https://github.com/jeaiii/ce
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "sort.h"
+#include "atomic.h"
+
+namespace ce
+{
+    // sorts one range on up to W threads without creating any: call reset() once, then each
+    // participating thread calls run() with its own worker index, run() returns when the whole
+    // range is sorted. ranges are split by partitioning, each piece only depends on its own
+    // contents, so the result is the same for any number of threads.
+    template<size_t W, class T, class C = detail::sort_less> struct parallel_sort
+    {
+        // max tasks per sort and per worker deque, when out of either the splitting thread keeps the work
+        static constexpr uint32_t capacity = 4096;
+
+        struct task_t
+        {
+            T* a;
+            T* b;
+            size_t bad;
+            bool leftmost;
+        };
+
+        // Chase-Lev work-stealing deque of task indices, the owner pushes and takes at the bottom, thieves steal from the top
+        struct alignas(64) deque_t
+        {
+            atomic<int64_t> top;
+            atomic<int64_t> bottom;
+            atomic<uint32_t> items[capacity];
+        };
+
+        C less;
+        size_t cutoff;
+        size_t workers;
+        atomic<size_t> remaining;
+        atomic<uint32_t> task_count;
+        task_t tasks[capacity];
+        deque_t deques[W];
+
+        // thread_count is how many threads will call run(), pieces of serial_cutoff elements or less are sorted by a single thread
+        void reset(T* a, T* b, size_t thread_count, C compare = C{ }, size_t serial_cutoff = 4096)
+        {
+            CE_ASSERT(thread_count > 0 && thread_count <= W);
+
+            less = compare;
+            cutoff = serial_cutoff < 64 ? 64 : serial_cutoff;
+            workers = thread_count;
+            atomic_store(remaining, size_t(b - a));
+            atomic_store(task_count, 0u);
+            for (auto& d : deques)
+            {
+                atomic_store(d.top, 0);
+                atomic_store(d.bottom, 0);
+            }
+
+            // same bad partition budget as intro_sort, past it a piece is handed to intro_sort
+            size_t bad = 1;
+            for (size_t n = b - a; n > 1; n >>= 1)
+                ++bad;
+
+            if (a < b)
+                push(0, { a, b, bad, true });
+        }
+
+        void run(size_t worker)
+        {
+            CE_ASSERT(worker < workers);
+
+            while (atomic_load(remaining) != 0)
+            {
+                uint32_t index;
+                if (take(worker, index) || steal(worker, index))
+                    process(worker, tasks[index]);
+                else
+                    os::sleep_ns(0);
+            }
+        }
+
+        bool push(size_t worker, task_t task)
+        {
+            deque_t& d = deques[worker];
+            int64_t b = atomic_load(d.bottom);
+            int64_t t = atomic_load(d.top);
+            if (b - t >= int64_t(capacity))
+                return false;
+
+            uint32_t index = atomic_fetch_add(task_count, 1u);
+            if (index >= capacity)
+                return false;
+
+            tasks[index] = task;
+            atomic_store(d.items[b % capacity], index);
+            atomic_store(d.bottom, b + 1);
+            return true;
+        }
+
+        bool take(size_t worker, uint32_t& index)
+        {
+            deque_t& d = deques[worker];
+            int64_t b = atomic_load(d.bottom) - 1;
+            atomic_store(d.bottom, b);
+            atomic_thread_fence();
+            int64_t t = atomic_load(d.top);
+
+            if (t > b)
+            {
+                atomic_store(d.bottom, b + 1);
+                return false;
+            }
+
+            index = atomic_load(d.items[b % capacity]);
+            if (t < b)
+                return true;
+
+            // last item, race the thieves for it
+            bool won = atomic_compare_exchange(d.top, t, t + 1);
+            atomic_store(d.bottom, b + 1);
+            return won;
+        }
+
+        bool steal(size_t worker, uint32_t& index)
+        {
+            for (size_t i = 1; i < workers; ++i)
+            {
+                deque_t& d = deques[(worker + i) % workers];
+                int64_t t = atomic_load(d.top);
+                atomic_thread_fence();
+                int64_t b = atomic_load(d.bottom);
+                if (t < b)
+                {
+                    index = atomic_load(d.items[t % capacity]);
+                    if (atomic_compare_exchange(d.top, t, t + 1))
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        void done(size_t n)
+        {
+            atomic_fetch_sub(remaining, n);
+        }
+
+        void process(size_t worker, task_t task)
+        {
+            T* a = task.a;
+            T* b = task.b;
+
+            for (;;)
+            {
+                size_t n = b - a;
+                if (n <= cutoff || task.bad == 0)
+                {
+                    intro_sort(a, b, less);
+                    return done(n);
+                }
+
+                detail::choose_pivot(a, b, less);
+
+                // same equal key shortcut as intro_sort, *(a - 1) is a placed pivot no one moves again
+                if (!task.leftmost && !less(a[-1], *a))
+                {
+                    T* p = detail::partition_left(a, b, less);
+                    done(size_t(p + 1 - a));
+                    a = p + 1;
+                    continue;
+                }
+
+                bool sorted;
+                T* p = detail::is_sort_branchless<remove_cv_t<T>, C>
+                    ? detail::partition_right_branchless(a, b, sorted, less)
+                    : detail::partition_right(a, b, sorted, less);
+                done(1);
+
+                if (size_t(p - a) < n / 8 || size_t(b - p - 1) < n / 8)
+                    --task.bad;
+
+                // offer the left side to the other workers and keep going on the right
+                task_t left{ a, p, task.bad, task.leftmost };
+                if (a < p && !push(worker, left))
+                    process(worker, left);
+
+                a = p + 1;
+                task.leftmost = false;
+            }
+        }
+    };
+}
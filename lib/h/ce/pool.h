@@ -24,6 +24,7 @@ SOFTWARE.
 */
 
 #include "ce.h"
+#include "atomic.h"
 
 namespace ce
 {
@@ -48,12 +49,16 @@ namespace ce
         index_t size;
         T data[N];
 
+        // allocated nodes, so live nodes can be visited in order without following the free list
+        bitset<N> live;
+
         static size_t capacity() { return N; }
 
         void reset()
         {
             size = 0;
             next[0] = 0;
+            live.reset();
         }
 
         index_t alloc_index()
@@ -62,11 +67,12 @@ namespace ce
             if (node != 0)
             {
                 next[0] = next[node];
+                live.set(node);
                 return node;
             }
 
             if (size < N - 1)
-                node = ++size;
+                node = ++size, live.set(node);
 
             return node;
         }
@@ -77,9 +83,25 @@ namespace ce
             {
                 next[node] = next[0];
                 next[0] = node;
+                live.reset(node);
             }
         }
 
+        // the next live node after `node`, 0 if there are no more
+        // for (auto i = p.next_live(0); i != 0; i = p.next_live(i))
+        index_t next_live(index_t node) const
+        {
+            auto i = live.find_next(size_t(node) + 1);
+            return i <= size ? index_t(i) : 0;
+        }
+
+        // call f(index, data) for every live node in index order
+        template<class F> void for_each_live(F&& f)
+        {
+            for (auto i = next_live(0); i != 0; i = next_live(i))
+                f(i, data[i]);
+        }
+
         struct queue_t
         {
             ptr_t tail = ptr_t::nil;
@@ -110,6 +132,7 @@ namespace ce
 
             // make head the free list
             next[0] = head;
+            live.reset(head);
 
             // is queue now empty?
             if (head == tail)
@@ -180,4 +203,519 @@ namespace ce
             return true;
         }
     };
+
+    // pool handing out handles that pack a node index with the node's generation
+    // freeing a node bumps its generation so any handle still referring to it is detected as stale with one compare
+    // a node's generation wraps after it is reused 2^bits times
+    template<size_t N, class T, class IndexT = uint16_t>
+    struct generational_pool
+    {
+        using index_t = IndexT;
+        using generation_t = IndexT;
+        using pool_t = pool<N, T, IndexT>;
+
+        using packed_t = cond_t<sizeof(index_t) <= 2, uint32_t, uint64_t>;
+
+        static constexpr size_t index_bits = sizeof(index_t) * 8;
+
+        // index in the low bits, generation in the high bits
+        enum class handle_t : packed_t { nil };
+
+        static constexpr auto nil = handle_t::nil;
+
+        pool_t items;
+        generation_t generations[N];
+
+        static size_t capacity() { return N; }
+
+        static index_t index_of(handle_t h) { return index_t(packed_t(h)); }
+        static generation_t generation_of(handle_t h) { return generation_t(packed_t(h) >> index_bits); }
+
+        // handles from before a reset are not detected as stale
+        void reset()
+        {
+            items.reset();
+            CE_MEMSET(generations, 0, sizeof(generations));
+        }
+
+        handle_t alloc()
+        {
+            auto node = items.alloc_index();
+            return node == 0 ? nil : handle_t(node | packed_t(generations[node]) << index_bits);
+        }
+
+        bool is_valid(handle_t h) const
+        {
+            auto node = index_of(h);
+            return node != 0 && node <= items.size && generations[node] == generation_of(h);
+        }
+
+        bool free(handle_t h)
+        {
+            if (!is_valid(h))
+                return false;
+
+            auto node = index_of(h);
+            ++generations[node];
+            items.free_index(node);
+            return true;
+        }
+
+        // nullptr if the handle is stale
+        T* get(handle_t h) { return is_valid(h) ? &items.data[index_of(h)] : nullptr; }
+        T const* get(handle_t h) const { return is_valid(h) ? &items.data[index_of(h)] : nullptr; }
+    };
+
+    namespace detail
+    {
+        template<size_t I, size_t N, class T> struct soa_column { T data[N]; };
+
+        template<size_t N, class, class> struct soa_columns;
+        template<size_t N, size_t...Is, class...Ts> struct soa_columns<N, items<size_t, Is...>, types<Ts...>> : soa_column<Is, N, Ts>...
+        {
+            void move(size_t to, size_t from)
+            {
+                CE_FOLD_LEFT_COMMA((soa_column<Is, N, Ts>::data[to] = static_cast<Ts&&>(soa_column<Is, N, Ts>::data[from])));
+            }
+        };
+    }
+
+    // pool storing each field of types<Ts...> in its own array so a sweep over one field touches only that field
+    // live objects are kept dense, field arrays [0, size) are all live objects, freeing moves the last object into the hole
+    // objects are referred to by stable ids, slots[id] is where an object's fields are and ids[slot] maps back
+    template<size_t N, class Fields, class IndexT = uint16_t> struct soa_pool;
+
+    template<size_t N, class...Ts, class IndexT>
+    struct soa_pool<N, types<Ts...>, IndexT>
+    {
+        using index_t = IndexT;
+
+        static_assert(index_t(N - 1) == N - 1, "");
+
+        // id 0 is unused
+
+        enum class ptr_t : index_t { nil };
+
+        static constexpr auto nil = ptr_t::nil;
+
+        template<size_t I> using field_t = select_t<I, Ts...>;
+
+        index_t size;
+        index_t fresh; // ids [1, fresh] have been handed out, ids[size, fresh) are the free ones
+
+        index_t slots[N];
+        index_t ids[N];
+
+        detail::soa_columns<N, sequence_t<size_t, sizeof...(Ts)>, types<Ts...>> columns;
+
+        static size_t capacity() { return N - 1; }
+
+        void reset()
+        {
+            size = 0;
+            fresh = 0;
+        }
+
+        bool is_live(index_t id) const
+        {
+            return id != 0 && id <= fresh && slots[id] < size && ids[slots[id]] == id;
+        }
+
+        index_t alloc_index()
+        {
+            if (size >= N - 1)
+                return 0;
+
+            if (size == fresh)
+                ids[size] = ++fresh;
+
+            auto id = ids[size];
+            slots[id] = size++;
+            return id;
+        }
+
+        bool free_index(index_t id)
+        {
+            if (!is_live(id))
+                return false;
+
+            auto slot = slots[id];
+            auto last = --size;
+
+            if (slot != last)
+            {
+                columns.move(slot, last);
+                ids[slot] = ids[last];
+                slots[ids[slot]] = slot;
+            }
+
+            // park the id with the free ones
+            ids[last] = id;
+            slots[id] = last;
+            return true;
+        }
+
+        // contiguous array of field I for all live objects, ids[k] is the id of the k-th
+        template<size_t I> field_t<I>* field() { return static_cast<detail::soa_column<I, N, field_t<I>>&>(columns).data; }
+        template<size_t I> field_t<I> const* field() const { return static_cast<detail::soa_column<I, N, field_t<I>> const&>(columns).data; }
+
+        template<size_t I> span<field_t<I>> field_span() { return { size, field<I>() }; }
+        template<size_t I> span<field_t<I> const> field_span() const { return { size, field<I>() }; }
+
+        template<size_t I> field_t<I>& get(index_t id) { return field<I>()[slots[id]]; }
+        template<size_t I> field_t<I> const& get(index_t id) const { return field<I>()[slots[id]]; }
+    };
+
+    // pool that any number of threads can alloc from and free to without a lock
+    // the free list is a treiber stack, its head packs the top index with a tag bumped on every pop
+    // so a thread that read a stale head can't succeed its compare exchange after the node was popped and pushed again (ABA)
+    // threads that alloc and free a lot can keep a magazine of free indices to touch the shared head less often
+    template<size_t N, class T, class IndexT = uint16_t>
+    struct concurrent_pool
+    {
+        using index_t = IndexT;
+
+        static_assert(index_t(N - 1) == N - 1, "");
+        static_assert(sizeof(index_t) <= 4, "");
+
+        // data[0] is unused
+
+        enum class ptr_t : index_t { nil };
+
+        static constexpr auto nil = ptr_t::nil;
+
+        using head_t = cond_t<sizeof(index_t) <= 2, uint32_t, uint64_t>;
+
+        static constexpr head_t index_mask = head_t(index_t(~index_t(0)));
+        static constexpr head_t tag_one = index_mask + 1;
+
+        atomic<head_t> free_head;
+        atomic<index_t> size;
+
+        // links to the next node, only meaningful for nodes on the free list (or to link nodes externally)
+        atomic<index_t> next[N];
+
+        T data[N];
+
+        static size_t capacity() { return N; }
+
+        // not thread safe
+        void reset()
+        {
+            atomic_store(free_head, 0);
+            atomic_store(size, 0);
+        }
+
+        index_t alloc_index()
+        {
+            for (head_t head = atomic_load(free_head);;)
+            {
+                auto node = index_t(head & index_mask);
+                if (node == 0)
+                    break;
+
+                // next[node] may be stale if another thread popped node first, but then the tag changed and this fails
+                head_t top = atomic_load(next[node]) | ((head & ~index_mask) + tag_one);
+                if (atomic_compare_exchange(free_head, head, top))
+                    return node;
+            }
+
+            for (index_t n = atomic_load(size); n < N - 1;)
+                if (atomic_compare_exchange(size, n, index_t(n + 1)))
+                    return index_t(n + 1);
+
+            return 0;
+        }
+
+        // push the chain first -> ... -> last, already linked through next[], with one compare exchange
+        void free_chain(index_t first, index_t last)
+        {
+            if (first == 0)
+                return;
+
+            head_t head = atomic_load(free_head);
+            do atomic_store(next[last], index_t(head & index_mask));
+            while (!atomic_compare_exchange(free_head, head, first | (head & ~index_mask)));
+        }
+
+        void free_index(index_t node)
+        {
+            free_chain(node, node);
+        }
+
+        // per thread cache of free indices, refilled from and flushed to the shared free list half a magazine at a time
+        struct magazine_t
+        {
+            static constexpr size_t capacity = 32;
+
+            size_t size;
+            index_t items[capacity];
+        };
+
+        index_t alloc_index(magazine_t& m)
+        {
+            if (m.size == 0)
+            {
+                for (index_t node; m.size < magazine_t::capacity / 2; m.items[m.size++] = node)
+                    if ((node = alloc_index()) == 0)
+                        break;
+            }
+
+            return m.size > 0 ? m.items[--m.size] : 0;
+        }
+
+        void free_index(magazine_t& m, index_t node)
+        {
+            if (node == 0)
+                return;
+
+            if (m.size == magazine_t::capacity)
+                flush(m, magazine_t::capacity / 2);
+
+            m.items[m.size++] = node;
+        }
+
+        // return the `n` most recently freed indices of the magazine to the pool
+        void flush(magazine_t& m, size_t n = magazine_t::capacity)
+        {
+            if (n > m.size)
+                n = m.size;
+
+            if (n == 0)
+                return;
+
+            auto first = m.items[m.size - n];
+            for (size_t i = m.size - n; i + 1 < m.size; ++i)
+                atomic_store(next[m.items[i]], m.items[i + 1]);
+
+            free_chain(first, m.items[m.size - 1]);
+            m.size -= n;
+        }
+
+        // intrusive multi producer single consumer queue linking pool nodes through next[] (vyukov)
+        // head is a stub node, the consumer only ever reads the node after it
+        // a producer is between its exchange and its store for an instant, the consumer then just sees the queue as empty
+        struct mpsc_queue_t
+        {
+            atomic<index_t> tail;
+            index_t head;
+        };
+
+        // not thread safe, takes a node from the pool for the stub
+        bool reset(mpsc_queue_t& q)
+        {
+            auto stub = alloc_index();
+            if (stub == 0)
+                return false;
+
+            atomic_store(next[stub], 0);
+            q.head = stub;
+            atomic_store(q.tail, stub);
+            return true;
+        }
+
+        // any thread
+        bool append_tail(mpsc_queue_t& q, T const& item)
+        {
+            auto node = alloc_index();
+            if (node == 0)
+                return false;
+
+            data[node] = item;
+            atomic_store(next[node], 0);
+
+            auto prev = atomic_exchange(q.tail, node);
+            atomic_store(next[prev], node);
+            return true;
+        }
+
+        // consumer thread only, the removed item's node becomes the new stub and the old stub is freed
+        bool remove_head(mpsc_queue_t& q, T& item)
+        {
+            auto stub = q.head;
+            auto node = atomic_load(next[stub]);
+            if (node == 0)
+                return false;
+
+            item = data[node];
+            q.head = node;
+            free_index(stub);
+            return true;
+        }
+    };
+
+    // single producer single consumer ring of N pool indices (or any small values)
+    // head and tail run freely and are on their own cache lines, each written by only one side
+    template<size_t N, class IndexT = uint16_t>
+    struct spsc_ring
+    {
+        using index_t = IndexT;
+
+        static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+        alignas(64) atomic<size_t> head; // written by the consumer
+        alignas(64) atomic<size_t> tail; // written by the producer
+        alignas(64) index_t items[N];
+
+        static size_t capacity() { return N; }
+
+        void reset()
+        {
+            atomic_store(head, 0);
+            atomic_store(tail, 0);
+        }
+
+        // producer thread only
+        bool append_tail(index_t item)
+        {
+            auto t = atomic_load(tail);
+            if (t - atomic_load(head) >= N)
+                return false;
+
+            items[t % N] = item;
+            atomic_store(tail, t + 1);
+            return true;
+        }
+
+        // consumer thread only
+        bool remove_head(index_t& item)
+        {
+            auto h = atomic_load(head);
+            if (atomic_load(tail) == h)
+                return false;
+
+            item = items[h % N];
+            atomic_store(head, h + 1);
+            return true;
+        }
+    };
+
+    // pool of up to N objects that reserves address space for all of them up front
+    // and commits memory a chunk at a time as it grows, so indices and pointers stay stable
+    template<size_t N, class T, class IndexT = uint32_t>
+    struct chunked_pool
+    {
+        using index_t = IndexT;
+
+        static_assert(index_t(N - 1) == N - 1, "");
+
+        // data[0] is unused
+
+        enum class ptr_t : index_t { nil };
+
+        static constexpr auto nil = ptr_t::nil;
+
+        // commit granularity, a multiple of any page size
+        static constexpr size_t chunk_bytes = 64 * 1024;
+
+        static constexpr size_t round_up(size_t n) { return (n + chunk_bytes - 1) / chunk_bytes * chunk_bytes; }
+
+        static constexpr size_t next_bytes = round_up(N * sizeof(index_t));
+        static constexpr size_t data_bytes = round_up(N * sizeof(T));
+
+        uint8_t* base;
+
+        // next[0] is the free list
+        index_t* next;
+        T* data;
+
+        index_t size;
+        size_t committed; // nodes [0, committed) have memory
+
+        size_t next_committed; // bytes
+        size_t data_committed; // bytes
+
+        static size_t capacity() { return N; }
+
+        // reserve the address space, false if the os can't
+        bool reserve()
+        {
+            base = os::virtual_reserve(next_bytes + data_bytes);
+            next = reinterpret_cast<index_t*>(base);
+            data = reinterpret_cast<T*>(base + next_bytes);
+            size = 0;
+            committed = 0;
+            next_committed = 0;
+            data_committed = 0;
+            return base != nullptr && grow(1);
+        }
+
+        void release()
+        {
+            if (base != nullptr)
+            {
+                destroy_at(data, 0, committed);
+                os::virtual_free(base, next_bytes + data_bytes);
+            }
+            base = nullptr;
+            next = nullptr;
+            data = nullptr;
+            committed = 0;
+        }
+
+        // keeps the committed memory
+        void reset()
+        {
+            size = 0;
+            next[0] = 0;
+        }
+
+        // commit enough for `count` nodes
+        bool grow(size_t count)
+        {
+            if (count > N)
+                count = N;
+
+            if (count <= committed)
+                return true;
+
+            auto n = round_up(count * sizeof(index_t));
+            if (n > next_committed)
+            {
+                if (!os::virtual_commit(base + next_committed, n - next_committed))
+                    return false;
+                next_committed = n;
+            }
+
+            auto d = round_up(count * sizeof(T));
+            if (d > data_committed)
+            {
+                if (!os::virtual_commit(base + next_bytes + data_committed, d - data_committed))
+                    return false;
+                data_committed = d;
+            }
+
+            // construct as many nodes as now fit in both
+            auto fit = next_committed / sizeof(index_t) < data_committed / sizeof(T) ? next_committed / sizeof(index_t) : data_committed / sizeof(T);
+            committed = construct_at(data, committed, fit < N ? fit : N);
+            return true;
+        }
+
+        index_t alloc_index()
+        {
+            auto node = next[0];
+            if (node != 0)
+            {
+                next[0] = next[node];
+                return node;
+            }
+
+            if (size < N - 1 && (size + 1u < committed || grow(size + 2u)))
+                node = ++size;
+
+            return node;
+        }
+
+        void free_index(index_t node)
+        {
+            if (node != 0)
+            {
+                next[node] = next[0];
+                next[0] = node;
+            }
+        }
+
+        T& operator[](index_t node) { return data[node]; }
+        T const& operator[](index_t node) const { return data[node]; }
+    };
 }
@@ -25,121 +25,1526 @@ SOFTWARE.
 
 #include "ce.h"
 
+#if CE_CPU_X86
+#include <emmintrin.h>
+#endif
+
+// 8 lane avx2 sorting networks, always used when built with -mavx2 or /arch:AVX2, otherwise on x86-64 they are
+// compiled for avx2 on their own and picked at run time if the cpu has it
+#if defined(__AVX2__)
+#define CE_SORT_AVX2 1
+#define CE_SORT_AVX2_TARGET
+#define CE_SORT_AVX2_DISPATCH 0
+#elif CE_CPU_X86_64 && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define CE_SORT_AVX2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define CE_SORT_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define CE_SORT_AVX2_TARGET
+#endif
+#define CE_SORT_AVX2_DISPATCH 1
+#else
+#define CE_SORT_AVX2 0
+#define CE_SORT_AVX2_DISPATCH 0
+#endif
+
+// network kernels are forced inline into the avx2 entry point so it is all compiled for avx2, even in debug builds
+#if defined(__GNUC__) || defined(__clang__)
+#define CE_SORT_INLINE inline __attribute__((always_inline))
+#else
+#define CE_SORT_INLINE inline
+#endif
+
+#if CE_SORT_AVX2
+#include <immintrin.h>
+#endif
+
+#if CE_SORT_AVX2_DISPATCH && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace ce
 {
-    template<class T>
-    void insertion_sort(T* a, T* b)
+    // every algorithm takes an optional strict weak ordering less(a, b) and an optional key
+    // projection key(a), sorting by less(key(a), key(b)), elements are moved, never copied
+    namespace detail
+    {
+        struct sort_less
+        {
+            template<class A, class B> bool operator()(A const& a, B const& b) const { return a < b; }
+        };
+
+        struct sort_identity
+        {
+            template<class A> A const& operator()(A const& a) const { return a; }
+        };
+
+        template<class T>
+        void reverse(T* a, T* b)
+        {
+            while (a < b && a < --b)
+                swap(*a++, *b);
+        }
+
+        template<class C, class P> struct sort_by
+        {
+            C less;
+            P key;
+
+            template<class T> bool operator()(T const& a, T const& b) const { return less(key(a), key(b)); }
+        };
+    }
+
+    template<class T, class C>
+    void insertion_sort(T* a, T* b, C less)
     {
         for (T* p = a; p < b; ++p)
         {
-            auto k = *p;
-            auto q = p;
-            for (; q > a && k < *(q - 1); --q)
-                *q = *(q - 1);
-            *q = k;
+            T k = move(*p);
+            T* q = p;
+            for (; q > a && less(k, *(q - 1)); --q)
+                *q = move(*(q - 1));
+            *q = move(k);
         }
     }
 
-    // median in b
     template<class T>
-    void median(T& a, T& b, T& c)
+    void insertion_sort(T* a, T* b)
     {
-        if (a < b)
+        insertion_sort(a, b, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void insertion_sort(T* a, T* b, C less, P key)
+    {
+        insertion_sort(a, b, detail::sort_by<C, P>{ less, key });
+    }
+
+    // median in b
+    template<class T, class C>
+    void median(T& a, T& b, T& c, C less)
+    {
+        if (less(a, b))
         {
-            if (b < c)
+            if (less(b, c))
                 return;  // a < b < c
-            if (a < c)
+            if (less(a, c))
                 return swap(b, c); // a < c < b
             swap(b, a); // c < a < b
         }
         else
         {
-            if (c < b)
+            if (less(c, b))
                 return; // c < b < a;
-            if (a < c)
+            if (less(a, c))
                 return swap(b, a); // b < a < c
             swap(b, c); // b < c < a
         }
     }
 
     template<class T>
-    T* partition(T* a, T* b)
+    void median(T& a, T& b, T& c)
+    {
+        median(a, b, c, detail::sort_less{});
+    }
+
+    template<class T, class C>
+    void heap_sort(T* a, T* b, C less)
     {
+        // heap_lower builds a min heap, so popping into the tail leaves [a, b) descending
         size_t n = b - a;
-        T* e = b - 1;
-        median(*a, *e, *(n / 2 + a));
-        T k = *e;
-        T* p = a;
+        for (size_t i = n / 2; i-- > 0;)
+            heap_lower(n, a, move(a[i]), i, less);
+
+        for (size_t i = n; i-- > 1;)
+        {
+            T item = move(a[i]);
+            a[i] = move(a[0]);
+            heap_lower(i, a, move(item), 0, less);
+        }
+
+        detail::reverse(a, b);
+    }
+
+    template<class T>
+    void heap_sort(T* a, T* b)
+    {
+        heap_sort(a, b, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void heap_sort(T* a, T* b, C less, P key)
+    {
+        heap_sort(a, b, detail::sort_by<C, P>{ less, key });
+    }
+
+    // pattern-defeating quicksort (Orson Peters) with BlockQuicksort partitioning (Edelkamp & Weiss)
+    namespace detail
+    {
+        constexpr size_t sort_ninther_threshold = 128;
+        constexpr size_t sort_partial_insertion_limit = 8;
+        constexpr size_t sort_block_size = 64;
+
+        // block partitioning only pays off when compares are cheap and branch free
+        template<class T, class C> constexpr bool is_sort_branchless = is_same_v<C, sort_less> && has_v<T,
+            char, signed char, unsigned char, short, unsigned short, int, unsigned, long, unsigned long, long long, unsigned long long, float, double>;
+
+        template<class T, class C>
+        void sort2(T& a, T& b, C& less)
+        {
+            if (less(b, a))
+                swap(a, b);
+        }
+
+        template<class T, class C>
+        void sort3(T& a, T& b, T& c, C& less)
+        {
+            sort2(a, b, less);
+            sort2(b, c, less);
+            sort2(a, b, less);
+        }
+
+        // *(a - 1) is not greater than anything in [a, b) so the inner loop needs no bounds check
+        template<class T, class C>
+        void unguarded_insertion_sort(T* a, T* b, C& less)
+        {
+            for (T* p = a; p < b; ++p)
+            {
+                T k = move(*p);
+                T* q = p;
+                for (; less(k, *(q - 1)); --q)
+                    *q = move(*(q - 1));
+                *q = move(k);
+            }
+        }
+
+        // insertion sort that gives up after a few moves, true if [a, b) ended up sorted
+        template<class T, class C>
+        bool partial_insertion_sort(T* a, T* b, C& less)
+        {
+            size_t moves = 0;
+            for (T* p = a; p < b; ++p)
+            {
+                if (p == a || !less(*p, *(p - 1)))
+                    continue;
+
+                T k = move(*p);
+                T* q = p;
+                for (; q > a && less(k, *(q - 1)); --q)
+                    *q = move(*(q - 1));
+                *q = move(k);
+
+                moves += size_t(p - q);
+                if (moves > sort_partial_insertion_limit)
+                    return false;
+            }
+            return true;
+        }
+
+        // partition [a, b) around *a, equal elements go right, returns the pivot's final place
+        // sets sorted when no element had to move
+        template<class T, class C>
+        T* partition_right(T* a, T* b, bool& sorted, C& less)
+        {
+            T k = move(*a);
+            T* p = a;
+            T* q = b;
+
+            // pivot selection leaves an element >= k in (a, b)
+            while (less(*++p, k));
+
+            if (p - 1 == a)
+                while (p < q && !less(*--q, k));
+            else
+                while (!less(*--q, k));
+
+            sorted = p >= q;
+
+            while (p < q)
+            {
+                swap(*p, *q);
+                while (less(*++p, k));
+                while (!less(*--q, k));
+            }
+
+            *a = move(*--p);
+            *p = move(k);
+            return p;
+        }
+
+        template<class T>
+        void swap_offsets(T* a, T* b, uint8_t const* l, uint8_t const* r, size_t n, bool use_swaps)
+        {
+            if (use_swaps)
+            {
+                // keep reversed input linear
+                for (size_t i = 0; i < n; ++i)
+                    swap(a[l[i]], *(b - r[i]));
+            }
+            else if (n > 0)
+            {
+                // one cyclic permutation instead of n swaps
+                T* p = a + l[0];
+                T* q = b - r[0];
+                T t = move(*p);
+                *p = move(*q);
+                for (size_t i = 1; i < n; ++i)
+                {
+                    p = a + l[i];
+                    *q = move(*p);
+                    q = b - r[i];
+                    *p = move(*q);
+                }
+                *q = move(t);
+            }
+        }
+
+        // same contract as partition_right, but records misplaced elements a block at a time
+        // into offset buffers so the compare results never feed a branch
+        template<class T, class C>
+        T* partition_right_branchless(T* a, T* b, bool& sorted, C& less)
+        {
+            T k = move(*a);
+            T* p = a;
+            T* q = b;
+
+            while (less(*++p, k));
+
+            if (p - 1 == a)
+                while (p < q && !less(*--q, k));
+            else
+                while (!less(*--q, k));
+
+            sorted = p >= q;
+
+            if (!sorted)
+            {
+                swap(*p, *q);
+                ++p;
+
+                alignas(64) uint8_t offsets_l[sort_block_size];
+                alignas(64) uint8_t offsets_r[sort_block_size];
+
+                T* base_l = p;
+                T* base_r = q;
+                size_t count_l = 0;
+                size_t count_r = 0;
+                size_t start_l = 0;
+                size_t start_r = 0;
+
+                while (p < q)
+                {
+                    // refill whichever offset buffers are empty, splitting what is left when both are
+                    size_t unknown = size_t(q - p);
+                    size_t split_l = count_l == 0 ? (count_r == 0 ? unknown / 2 : unknown) : 0;
+                    size_t split_r = count_r == 0 ? unknown - split_l : 0;
+
+                    if (split_l > sort_block_size)
+                        split_l = sort_block_size;
+                    if (split_r > sort_block_size)
+                        split_r = sort_block_size;
+
+                    for (size_t i = 0; i < split_l; ++i)
+                    {
+                        offsets_l[count_l] = uint8_t(i);
+                        count_l += !less(*p, k);
+                        ++p;
+                    }
+
+                    for (size_t i = 0; i < split_r;)
+                    {
+                        offsets_r[count_r] = uint8_t(++i);
+                        count_r += less(*--q, k);
+                    }
+
+                    size_t n = count_l < count_r ? count_l : count_r;
+                    swap_offsets(base_l, base_r, offsets_l + start_l, offsets_r + start_r, n, count_l == count_r);
+                    count_l -= n;
+                    count_r -= n;
+                    start_l += n;
+                    start_r += n;
+
+                    if (count_l == 0)
+                    {
+                        start_l = 0;
+                        base_l = p;
+                    }
+
+                    if (count_r == 0)
+                    {
+                        start_r = 0;
+                        base_r = q;
+                    }
+                }
+
+                // at most one buffer has leftovers, move them to the boundary
+                if (count_l)
+                {
+                    while (count_l--)
+                        swap(base_l[offsets_l[start_l + count_l]], *--q);
+                    p = q;
+                }
+
+                if (count_r)
+                {
+                    while (count_r--)
+                        swap(*(base_r - offsets_r[start_r + count_r]), *p), ++p;
+                }
+            }
+
+            *a = move(*--p);
+            *p = move(k);
+            return p;
+        }
+
+        // partition [a, b) around *a, equal elements go left, returns the pivot's final place
+        template<class T, class C>
+        T* partition_left(T* a, T* b, C& less)
+        {
+            T k = move(*a);
+            T* p = a;
+            T* q = b;
+
+            // pivot selection leaves an element <= k in (a, b)
+            while (less(k, *--q));
+
+            if (q + 1 == b)
+                while (p < q && !less(k, *++p));
+            else
+                while (!less(k, *++p));
+
+            while (p < q)
+            {
+                swap(*p, *q);
+                while (less(k, *--q));
+                while (!less(k, *++p));
+            }
 
-        for (T* q = a; q < e; ++q)
-            if (*q < k)
-                swap(*p, *q), ++p;
-        swap(*p, *e);
-        return p;
+            *a = move(*q);
+            *q = move(k);
+            return q;
+        }
+
+        // leaves the median of 3 (or pseudo median of 9) in *a with elements <= and >= it in (a, b)
+        template<class T, class C>
+        void choose_pivot(T* a, T* b, C& less)
+        {
+            size_t n = b - a;
+            size_t m = n / 2;
+            if (n > sort_ninther_threshold)
+            {
+                sort3(a[0], a[m], b[-1], less);
+                sort3(a[1], a[m - 1], b[-2], less);
+                sort3(a[2], a[m + 1], b[-3], less);
+                sort3(a[m - 1], a[m], a[m + 1], less);
+                swap(a[0], a[m]);
+            }
+            else
+            {
+                sort3(a[m], a[0], b[-1], less);
+            }
+        }
+
+        // bitonic sorting networks for up to 64 32 or 64 bit keys, used for small ranges of plain arithmetic keys
+        constexpr size_t sort_network_max = 64;
+
+        // key kind for lane selection: 0 unsigned, 1 signed, 2 floating point
+        template<class T> constexpr int network_kind = is_same_v<T, float> || is_same_v<T, double> ? 2 : T(-1) < T(0) ? 1 : 0;
+
+        template<class T, class C> constexpr bool is_sort_network = is_sort_branchless<T, C> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+        // lanes = 1 means scalar only
+        template<size_t S, int K> struct network_scalar
+        {
+            static constexpr size_t lanes = 1;
+        };
+
+#if CE_SORT_AVX2
+        template<size_t S, int K> struct network_avx2_lanes : network_scalar<S, K> { };
+
+        template<> struct network_avx2_lanes<4, 0>
+        {
+            static constexpr size_t lanes = 8;
+            using v = __m256i;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_si256(static_cast<v const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_si256(static_cast<v*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { v s = _mm256_set1_epi32(int(0x80000000)); return _mm256_cmpgt_epi32(_mm256_xor_si256(b, s), _mm256_xor_si256(a, s)); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_epi8(b, a, m); }
+        };
+
+        template<> struct network_avx2_lanes<4, 1>
+        {
+            static constexpr size_t lanes = 8;
+            using v = __m256i;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_si256(static_cast<v const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_si256(static_cast<v*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { return _mm256_cmpgt_epi32(b, a); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_epi8(b, a, m); }
+        };
+
+        template<> struct network_avx2_lanes<4, 2>
+        {
+            static constexpr size_t lanes = 8;
+            using v = __m256;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_ps(static_cast<float const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_ps(static_cast<float*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permutevar8x32_ps(a, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_ps(b, a, m); }
+        };
+
+        template<> struct network_avx2_lanes<8, 0>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m256i;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_si256(static_cast<v const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_si256(static_cast<v*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permute4x64_epi64(a, 0x1b); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { v s = _mm256_set1_epi64x(int64_t(0x8000000000000000)); return _mm256_cmpgt_epi64(_mm256_xor_si256(b, s), _mm256_xor_si256(a, s)); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_epi8(b, a, m); }
+        };
+
+        template<> struct network_avx2_lanes<8, 1>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m256i;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_si256(static_cast<v const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_si256(static_cast<v*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permute4x64_epi64(a, 0x1b); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { return _mm256_cmpgt_epi64(b, a); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_epi8(b, a, m); }
+        };
+
+        template<> struct network_avx2_lanes<8, 2>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m256d;
+            CE_SORT_AVX2_TARGET static v load(void const* p) { return _mm256_loadu_pd(static_cast<double const*>(p)); }
+            CE_SORT_AVX2_TARGET static void store(void* p, v a) { _mm256_storeu_pd(static_cast<double*>(p), a); }
+            CE_SORT_AVX2_TARGET static v reverse(v a) { return _mm256_permute4x64_pd(a, 0x1b); }
+            CE_SORT_AVX2_TARGET static v less(v a, v b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+            CE_SORT_AVX2_TARGET static v select(v m, v a, v b) { return _mm256_blendv_pd(b, a, m); }
+        };
+
+        // vectors never cross a call so the avx2 kernels can be called from code built without avx
+        template<class L> struct network_avx2_ops : L
+        {
+            CE_SORT_AVX2_TARGET static void exchange(void* x, void* y)
+            {
+                auto a = L::load(x);
+                auto b = L::load(y);
+                auto m = L::less(b, a);
+                L::store(x, L::select(m, b, a));
+                L::store(y, L::select(m, a, b));
+            }
+
+            // against y reversed, the maxima are stored back reversed
+            CE_SORT_AVX2_TARGET static void exchange_reversed(void* x, void* y)
+            {
+                auto a = L::load(x);
+                auto b = L::reverse(L::load(y));
+                auto m = L::less(b, a);
+                L::store(x, L::select(m, b, a));
+                L::store(y, L::reverse(L::select(m, a, b)));
+            }
+        };
+
+        template<size_t S, int K> using network_avx2 = network_avx2_ops<network_avx2_lanes<S, K>>;
+#endif
+
+#if CE_CPU_X86
+        template<size_t S, int K> struct network_sse2_lanes : network_scalar<S, K> { };
+
+        // sse2 has no 64 bit compares, so only 32 bit keys get lanes
+        template<> struct network_sse2_lanes<4, 0>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m128i;
+            static v load(void const* p) { return _mm_loadu_si128(static_cast<v const*>(p)); }
+            static void store(void* p, v a) { _mm_storeu_si128(static_cast<v*>(p), a); }
+            static v reverse(v a) { return _mm_shuffle_epi32(a, 0x1b); }
+            static v less(v a, v b) { v s = _mm_set1_epi32(int(0x80000000)); return _mm_cmplt_epi32(_mm_xor_si128(a, s), _mm_xor_si128(b, s)); }
+            static v select(v m, v a, v b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+        };
+
+        template<> struct network_sse2_lanes<4, 1>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m128i;
+            static v load(void const* p) { return _mm_loadu_si128(static_cast<v const*>(p)); }
+            static void store(void* p, v a) { _mm_storeu_si128(static_cast<v*>(p), a); }
+            static v reverse(v a) { return _mm_shuffle_epi32(a, 0x1b); }
+            static v less(v a, v b) { return _mm_cmplt_epi32(a, b); }
+            static v select(v m, v a, v b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+        };
+
+        template<> struct network_sse2_lanes<4, 2>
+        {
+            static constexpr size_t lanes = 4;
+            using v = __m128;
+            static v load(void const* p) { return _mm_loadu_ps(static_cast<float const*>(p)); }
+            static void store(void* p, v a) { _mm_storeu_ps(static_cast<float*>(p), a); }
+            static v reverse(v a) { return _mm_shuffle_ps(a, a, 0x1b); }
+            static v less(v a, v b) { return _mm_cmplt_ps(a, b); }
+            static v select(v m, v a, v b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        };
+
+        template<class L> struct network_sse2_ops : L
+        {
+            static void exchange(void* x, void* y)
+            {
+                auto a = L::load(x);
+                auto b = L::load(y);
+                auto m = L::less(b, a);
+                L::store(x, L::select(m, b, a));
+                L::store(y, L::select(m, a, b));
+            }
+
+            static void exchange_reversed(void* x, void* y)
+            {
+                auto a = L::load(x);
+                auto b = L::reverse(L::load(y));
+                auto m = L::less(b, a);
+                L::store(x, L::select(m, b, a));
+                L::store(y, L::reverse(L::select(m, a, b)));
+            }
+        };
+
+        template<size_t S, int K> using network_sse2 = network_sse2_ops<network_sse2_lanes<S, K>>;
+#endif
+
+        // min and max from a single compare so equal but distinct keys (-0.0, +0.0) are never duplicated
+        template<class T>
+        void network_swap(T& a, T& b)
+        {
+            T x = a;
+            T y = b;
+            bool s = y < x;
+            a = s ? y : x;
+            b = s ? x : y;
+        }
+
+        // compare exchange a[i] with a[k - 1 - i] in each block of k, then a[i] with a[i + j] for j = k / 4 ... 1,
+        // every exchange is ascending so strides of at least a vector are straight loads, min/max and stores
+        template<size_t K, class L, class T>
+        CE_SORT_INLINE void network_sort(T* a)
+        {
+            for (size_t k = 2; k <= K; k *= 2)
+            {
+                for (size_t base = 0; base < K; base += k)
+                {
+                    T* p = a + base;
+                    size_t i = 0;
+                    if constexpr (L::lanes > 1)
+                    {
+                        for (; i + L::lanes <= k / 2; i += L::lanes)
+                            L::exchange_reversed(p + i, p + k - L::lanes - i);
+                    }
+                    for (; i < k / 2; ++i)
+                        network_swap(p[i], p[k - 1 - i]);
+                }
+
+                for (size_t j = k / 4; j > 0; j /= 2)
+                {
+                    for (size_t base = 0; base < K; base += j * 2)
+                    {
+                        T* p = a + base;
+                        size_t i = 0;
+                        if constexpr (L::lanes > 1)
+                        {
+                            for (; i + L::lanes <= j; i += L::lanes)
+                                L::exchange(p + i, p + i + j);
+                        }
+                        for (; i < j; ++i)
+                            network_swap(p[i], p[i + j]);
+                    }
+                }
+            }
+        }
+
+        template<size_t S, int K> using network_lanes =
+#if CE_SORT_AVX2 && !CE_SORT_AVX2_DISPATCH
+            network_avx2<S, K>;
+#elif CE_CPU_X86
+            network_sse2<S, K>;
+#else
+            network_scalar<S, K>;
+#endif
+
+        template<class L, class T>
+        CE_SORT_INLINE void network_sort_k(T* t, size_t k)
+        {
+            if (k == 8)
+                network_sort<8, L>(t);
+            else if (k == 16)
+                network_sort<16, L>(t);
+            else if (k == 32)
+                network_sort<32, L>(t);
+            else
+                network_sort<64, L>(t);
+        }
+
+#if CE_SORT_AVX2_DISPATCH
+        inline bool network_has_avx2()
+        {
+            static bool const has = []
+            {
+#if defined(_MSC_VER)
+                // avx2 in cpuid leaf 7 and the os saving ymm state
+                int r[4];
+                __cpuid(r, 0);
+                if (r[0] < 7)
+                    return false;
+                __cpuid(r, 1);
+                if ((r[2] >> 27 & 1) == 0 || (r[2] >> 28 & 1) == 0 || (_xgetbv(0) & 6) != 6)
+                    return false;
+                __cpuidex(r, 7, 0);
+                return (r[1] >> 5 & 1) != 0;
+#else
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+#endif
+            }();
+            return has;
+        }
+
+        // compiled for avx2 with the kernels inlined into it
+        template<class T>
+        CE_SORT_AVX2_TARGET void network_sort_avx2(T* t, size_t k)
+        {
+            network_sort_k<network_avx2<sizeof(T), network_kind<T>>>(t, k);
+        }
+#endif
+
+        // sorts n <= 64 keys, padding up to the network size with the largest key
+        template<class T>
+        void network_sort(T* a, size_t n)
+        {
+            CE_ASSERT(n <= sort_network_max);
+            if (n < 2)
+                return;
+
+            T t[sort_network_max];
+            T m = a[0];
+            for (size_t i = 0; i < n; ++i)
+            {
+                t[i] = a[i];
+                m = m < a[i] ? a[i] : m;
+            }
+
+            size_t k = n <= 8 ? 8 : n <= 16 ? 16 : n <= 32 ? 32 : 64;
+            for (size_t i = n; i < k; ++i)
+                t[i] = m;
+
+#if CE_SORT_AVX2_DISPATCH
+            if (network_has_avx2())
+                network_sort_avx2(t, k);
+            else
+#endif
+            network_sort_k<network_lanes<sizeof(T), network_kind<T>>>(t, k);
+
+            for (size_t i = 0; i < n; ++i)
+                a[i] = t[i];
+        }
+
+        // N is the insertion sort cutoff, needs to be at least 4 so the pattern breaking swaps stay inside each side
+        template<size_t N, bool Branchless, class T, class C>
+        void pdq_sort(T* a, T* b, size_t bad, bool leftmost, C& less)
+        {
+            for (;;)
+            {
+                size_t n = b - a;
+                if (n < N)
+                {
+                    if constexpr (is_sort_network<T, C>)
+                    {
+                        if (n <= sort_network_max)
+                            return network_sort(a, n);
+                    }
+                    return leftmost ? insertion_sort(a, b, less) : unguarded_insertion_sort(a, b, less);
+                }
+
+                choose_pivot(a, b, less);
+
+                // *(a - 1) was a pivot not greater than anything here, if it equals ours then
+                // [a, p] are all equal to it and only the right side needs sorting
+                if (!leftmost && !less(a[-1], *a))
+                {
+                    a = partition_left(a, b, less) + 1;
+                    continue;
+                }
+
+                bool sorted;
+                T* p = Branchless ? partition_right_branchless(a, b, sorted, less) : partition_right(a, b, sorted, less);
+
+                size_t l = p - a;
+                size_t r = b - p - 1;
+
+                if (l < n / 8 || r < n / 8)
+                {
+                    // too many bad partitions, bail out to guarantee n log n
+                    if (--bad == 0)
+                        return heap_sort(a, b, less);
+
+                    // shuffle a few elements to break up whatever pattern got us here
+                    if (l >= N)
+                    {
+                        swap(a[0], a[l / 4]);
+                        swap(p[-1], *(p - l / 4));
+                        if (l > sort_ninther_threshold)
+                        {
+                            swap(a[1], a[l / 4 + 1]);
+                            swap(a[2], a[l / 4 + 2]);
+                            swap(p[-2], *(p - (l / 4 + 1)));
+                            swap(p[-3], *(p - (l / 4 + 2)));
+                        }
+                    }
+
+                    if (r >= N)
+                    {
+                        swap(p[1], p[1 + r / 4]);
+                        swap(b[-1], *(b - r / 4));
+                        if (r > sort_ninther_threshold)
+                        {
+                            swap(p[2], p[2 + r / 4]);
+                            swap(p[3], p[3 + r / 4]);
+                            swap(b[-2], *(b - (1 + r / 4)));
+                            swap(b[-3], *(b - (2 + r / 4)));
+                        }
+                    }
+                }
+                else if (sorted && partial_insertion_sort(a, p, less) && partial_insertion_sort(p + 1, b, less))
+                {
+                    // balanced and nothing moved, likely already (or nearly) sorted
+                    return;
+                }
+
+                pdq_sort<N, Branchless>(a, p, bad, leftmost, less);
+                a = p + 1;
+                leftmost = false;
+            }
+        }
     }
 
-    template<size_t N, class T>
-    void intro_sort(T* a, T* b, size_t intro)
+    // pivot ends up in *p with [a, p) < *p <= (p, b)
+    template<class T, class C>
+    T* partition(T* a, T* b, C less)
     {
         size_t n = b - a;
-        if (n < N)
-            return insertion_sort(a, b);
+        if (n < 3)
+        {
+            if (n == 2)
+                detail::sort2(a[0], a[1], less);
+            return a;
+        }
+
+        bool sorted;
+        detail::choose_pivot(a, b, less);
+        return detail::partition_right(a, b, sorted, less);
+    }
 
-        //if (limit == 0)
-        //    return heap_sort();
+    template<class T>
+    T* partition(T* a, T* b)
+    {
+        return partition(a, b, detail::sort_less{});
+    }
 
-        T* p = partition(a, b);
-        size_t limit = intro / 2;
-        intro_sort<N, T>(p + 1, b, limit);
-        intro_sort<N, T>(a, p, limit);
+    template<class T, class C, class P>
+    T* partition(T* a, T* b, C less, P key)
+    {
+        return partition(a, b, detail::sort_by<C, P>{ less, key });
     }
 
-    template<size_t N = 128, class T>
-    void intro_sort(T* a, T* b)
+    // N is the size below which partitioning stops for insertion sort (at least 4), ranges of up to 64
+    // 4 and 8 byte arithmetic keys with the default compare skip all of it for a sorting network
+    template<size_t N = 24, class T, class C>
+    void intro_sort(T* a, T* b, C less)
     {
+        // allow log2(n) unbalanced partitions before falling back to heap_sort
+        size_t bad = 1;
+        for (size_t n = b - a; n > 1; n >>= 1)
+            ++bad;
+
+        if constexpr (detail::is_sort_network<remove_cv_t<T>, C>)
+        {
+            if (size_t(b - a) <= detail::sort_network_max)
+                return detail::network_sort(a, size_t(b - a));
+        }
+
+        constexpr size_t M = N < 4 ? 4 : N;
         if (a < b)
+            detail::pdq_sort<M, detail::is_sort_branchless<remove_cv_t<T>, C>>(a, b, bad, true, less);
+    }
+
+    template<size_t N = 24, class T>
+    void intro_sort(T* a, T* b)
+    {
+        intro_sort<N>(a, b, detail::sort_less{});
+    }
+
+    template<size_t N = 24, class T, class C, class P>
+    void intro_sort(T* a, T* b, C less, P key)
+    {
+        intro_sort<N>(a, b, detail::sort_by<C, P>{ less, key });
+    }
+
+    namespace detail
+    {
+        template<size_t S> using radix_bits_t = select_t<S == 1 ? 0 : S == 2 ? 1 : S == 4 ? 2 : 3, uint8_t, uint16_t, uint32_t, uint64_t>;
+
+        // maps an arithmetic key to an unsigned integer of the same size with the same order
+        template<class T>
+        radix_bits_t<sizeof(T)> radix_key(T n)
         {
-            size_t n = b - a;
-            if (n < N)
-                return insertion_sort(a, b);
+            using U = radix_bits_t<sizeof(T)>;
+            constexpr U sign = U(U(1) << (sizeof(T) * 8 - 1));
+
+            if constexpr (is_same_v<T, float> || is_same_v<T, double>)
+            {
+                // negative floats flip every bit, positive ones just the sign
+                U u;
+                CE_MEMCPY(&u, &n, sizeof(u));
+                return U(u ^ (U(0 - (u >> (sizeof(T) * 8 - 1))) | sign));
+            }
+            else if constexpr (T(-1) < T(0))
+                return U(U(n) ^ sign);
+            else
+                return U(n);
+        }
+
+        template<size_t D, class T, class U>
+        void radix_scatter(T const* a, T* out, U* pa, U* pout, size_t n, size_t shift, uint32_t* offsets)
+        {
+            constexpr size_t mask = (size_t(1) << D) - 1;
+            for (size_t i = 0; i < n; ++i)
+            {
+                size_t j = offsets[size_t(radix_key(a[i]) >> shift) & mask]++;
+                out[j] = a[i];
+                if constexpr (!is_same_v<U, void>)
+                    pout[j] = move(pa[i]);
+            }
+        }
+
+        // turns counts into starting offsets, false if every key lands in one bucket and the pass can be skipped
+        template<size_t D>
+        bool radix_offsets(uint32_t* counts, size_t n)
+        {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < (size_t(1) << D); ++i)
+            {
+                uint32_t c = counts[i];
+                if (c == n)
+                    return false;
+                counts[i] = sum;
+                sum += c;
+            }
+            return true;
+        }
 
-            T* p = partition(a, b);
-            intro_sort<N, T>(a, p, n);
-            intro_sort<N, T>(p + 1, b, n);
+        // counts is the caller's histogram of 1 << D entries or null to keep it on the stack
+        template<size_t D, class T, class U>
+        void radix_sort(T* a, size_t n, T* scratch, U* pa, U* pscratch, uint32_t* counts)
+        {
+            CE_STATIC_ASSERT(D >= 1 && D <= 16, "digits wider than 16 bits make the histogram bigger than the data it sorts");
+            CE_ASSERT(n <= 0xffffffff);
+            CE_ASSERT(D <= 11 || counts != nullptr);
+
+            constexpr size_t bits = sizeof(T) * 8;
+            constexpr size_t passes = (bits + D - 1) / D;
+            constexpr size_t buckets = size_t(1) << D;
+            constexpr size_t mask = buckets - 1;
+
+            T* src = a;
+            T* dst = scratch;
+            U* psrc = pa;
+            U* pdst = pscratch;
+
+            if constexpr (passes * buckets * sizeof(uint32_t) <= 8192)
+            {
+                // small digits, one read builds every pass's histogram
+                uint32_t all[passes][buckets] = { };
+                for (size_t i = 0; i < n; ++i)
+                {
+                    auto k = radix_key(a[i]);
+                    for (size_t pass = 0; pass < passes; ++pass)
+                        ++all[pass][size_t(k >> (pass * D)) & mask];
+                }
+
+                for (size_t pass = 0; pass < passes; ++pass)
+                {
+                    if (!radix_offsets<D>(all[pass], n))
+                        continue;
+
+                    radix_scatter<D>(src, dst, psrc, pdst, n, pass * D, all[pass]);
+                    swap(src, dst);
+                    swap(psrc, pdst);
+                }
+            }
+            else
+            {
+                // wide digits, keeping every pass's histogram would be too much stack so count each pass as it comes
+                // in the caller's histogram if given, digits past 11 bits must have one as the stack stays under 8 KB
+                uint32_t local[D <= 11 ? buckets : 1];
+                if (counts == nullptr)
+                    counts = local;
+
+                for (size_t pass = 0; pass < passes; ++pass)
+                {
+                    CE_MEMSET(counts, 0, buckets * sizeof(uint32_t));
+                    for (size_t i = 0; i < n; ++i)
+                        ++counts[size_t(radix_key(src[i]) >> (pass * D)) & mask];
+
+                    if (!radix_offsets<D>(counts, n))
+                        continue;
+
+                    radix_scatter<D>(src, dst, psrc, pdst, n, pass * D, counts);
+                    swap(src, dst);
+                    swap(psrc, pdst);
+                }
+            }
+
+            // an odd number of passes left the result in scratch
+            if (src != a)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    a[i] = src[i];
+                    if constexpr (!is_same_v<U, void>)
+                        pa[i] = move(psrc[i]);
+                }
+            }
         }
     }
 
+    // stable LSD radix sort of integer or floating point keys in D bit digits, 1 to 11 (8 or 11 are the sweet spots)
+    // scratch must hold b - a keys, passes where every key has the same digit are skipped
+    // histograms live on the stack, all passes at once when that fits in 8 KB, otherwise 4 << D bytes counted a pass at a time
+    template<size_t D = 8, class T>
+    void radix_sort(T* a, T* b, T* scratch)
+    {
+        CE_STATIC_ASSERT(D <= 11, "digits wider than 11 bits need more histogram than belongs on the stack, pass counts");
+        detail::radix_sort<D, T, void>(a, size_t(b - a), scratch, nullptr, nullptr, nullptr);
+    }
+
+    // same, moving payload[i] along with a[i], payload_scratch must hold b - a payloads
+    template<size_t D = 8, class T, class U>
+    void radix_sort(T* a, T* b, T* scratch, U* payload, U* payload_scratch)
+    {
+        CE_STATIC_ASSERT(D <= 11, "digits wider than 11 bits need more histogram than belongs on the stack, pass counts");
+        detail::radix_sort<D, T, U>(a, size_t(b - a), scratch, payload, payload_scratch, nullptr);
+    }
+
+    // same with a caller provided histogram of 1 << D counts, for digits up to 16 bits so large arrays take fewer passes
+    template<size_t D, class T>
+    void radix_sort(T* a, T* b, T* scratch, uint32_t* counts)
+    {
+        detail::radix_sort<D, T, void>(a, size_t(b - a), scratch, nullptr, nullptr, counts);
+    }
+
+    template<size_t D, class T, class U>
+    void radix_sort(T* a, T* b, T* scratch, U* payload, U* payload_scratch, uint32_t* counts)
+    {
+        detail::radix_sort<D, T, U>(a, size_t(b - a), scratch, payload, payload_scratch, counts);
+    }
+
+    // first element where !less(key(*i), k), the probe only feeds a conditional move so random queries don't mispredict
+    template<class T, class K, class C, class P>
+    T const* lower_bound(T const* a, T const* b, K const& k, C less, P key)
+    {
+        size_t n = b - a;
+        if (n == 0)
+            return a;
+
+        for (; n > 1; n -= n / 2)
+        {
+            // touch both possible next probes so large arrays aren't one serial cache miss per step
+            size_t next = (n - n / 2) / 2;
+            CE_PREFETCH(a + next);
+            CE_PREFETCH(a + n / 2 + next);
+            a = less(key(a[n / 2]), k) ? a + n / 2 : a;
+        }
+
+        return a + less(key(*a), k);
+    }
+
+    template<class T, class K, class C>
+    T const* lower_bound(T const* a, T const* b, K const& k, C less)
+    {
+        return lower_bound(a, b, k, less, detail::sort_identity{});
+    }
+
     template<class T>
     T const* lower_bound(T const* a, T const* b, T k)
     {
-        for (size_t n = b - a; n > 0;)
+        return lower_bound(a, b, k, detail::sort_less{}, detail::sort_identity{});
+    }
+
+    // first element where less(k, key(*i))
+    template<class T, class K, class C, class P>
+    T const* upper_bound(T const* a, T const* b, K const& k, C less, P key)
+    {
+        size_t n = b - a;
+        if (n == 0)
+            return a;
+
+        for (; n > 1; n -= n / 2)
         {
-            size_t step = n / 2;
-            T const* i = a + step;
-            if (*i < k) {
-                a = ++i;
-                n -= step + 1;
-            }
-            else
-                n = step;
+            size_t next = (n - n / 2) / 2;
+            CE_PREFETCH(a + next);
+            CE_PREFETCH(a + n / 2 + next);
+            a = less(k, key(a[n / 2])) ? a : a + n / 2;
         }
-        return a;
+
+        return a + !less(k, key(*a));
+    }
+
+    template<class T, class K, class C>
+    T const* upper_bound(T const* a, T const* b, K const& k, C less)
+    {
+        return upper_bound(a, b, k, less, detail::sort_identity{});
     }
 
     template<class T>
     T const* upper_bound(T const* a, T const* b, T k)
     {
-        for (size_t n = b - a; n > 0;)
+        return upper_bound(a, b, k, detail::sort_less{}, detail::sort_identity{});
+    }
+
+    // out[i] = lower_bound(a, b, keys[i]) for m keys, running 16 searches in lock step (they all halve
+    // the same n) and prefetching each one's next probe so the cache misses overlap
+    template<class T, class K, class C, class P>
+    void lower_bound_n(T const* a, T const* b, size_t m, K const keys[], T const* out[], C less, P key)
+    {
+        constexpr size_t G = 16;
+
+        for (size_t g = 0; g < m; g += G)
+        {
+            size_t c = m - g < G ? m - g : G;
+            T const* base[G];
+            for (size_t j = 0; j < c; ++j)
+                base[j] = a;
+
+            size_t n = b - a;
+            if (n != 0)
+            {
+                for (; n > 1; n -= n / 2)
+                {
+                    size_t half = n / 2;
+                    size_t next = (n - half) / 2;
+                    for (size_t j = 0; j < c; ++j)
+                    {
+                        base[j] = less(key(base[j][half]), keys[g + j]) ? base[j] + half : base[j];
+                        CE_PREFETCH(base[j] + next);
+                    }
+                }
+
+                for (size_t j = 0; j < c; ++j)
+                    base[j] += less(key(*base[j]), keys[g + j]);
+            }
+
+            for (size_t j = 0; j < c; ++j)
+                out[g + j] = base[j];
+        }
+    }
+
+    template<class T, class K, class C>
+    void lower_bound_n(T const* a, T const* b, size_t m, K const keys[], T const* out[], C less)
+    {
+        lower_bound_n(a, b, m, keys, out, less, detail::sort_identity{});
+    }
+
+    template<class T>
+    void lower_bound_n(T const* a, T const* b, size_t m, T const keys[], T const* out[])
+    {
+        lower_bound_n(a, b, m, keys, out, detail::sort_less{}, detail::sort_identity{});
+    }
+
+    namespace detail
+    {
+        // in order walk of the implicit tree rooted at node k, giving each node the next sorted element
+        template<class T>
+        size_t eytzinger_layout(T const* a, T* out, size_t k, size_t n, size_t r)
         {
-            size_t step = n / 2;
-            T const* i = a + step;
-            if (!(k < *i)) {
-                a = ++i;
-                n -= step + 1;
+            if (k <= n)
+            {
+                r = eytzinger_layout(a, out, k + k, n, r);
+                out[k] = a[r];
+                r = eytzinger_layout(a, out, k + k + 1, n, r + 1);
             }
+            return r;
+        }
+    }
+
+    // lays sorted [a, b) out as an implicit binary search tree in bfs (eytzinger) order in out[1, b - a]
+    // out[0] is unused, searches walk down from the root touching one cache line per 4 levels with prefetch
+    template<class T>
+    void eytzinger_layout(T const* a, T const* b, T* out)
+    {
+        detail::eytzinger_layout(a, out, 1, size_t(b - a), 0);
+    }
+
+    // index into layout[1, n] of the first element where !less(key(element), k), 0 if there is none
+    template<class T, class K, class C, class P>
+    size_t eytzinger_lower_bound(T const* layout, size_t n, K const& k, C less, P key)
+    {
+        // prefetch the nodes 4 levels down, a cache line of 4 byte keys
+        constexpr size_t line = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+        // branchless descent remembering the last node not less than k
+        size_t j = 0;
+        for (size_t i = 1; i <= n;)
+        {
+            if (i * line <= n)
+                CE_PREFETCH(layout + i * line);
+            bool is_less = less(key(layout[i]), k);
+            j = is_less ? j : i;
+            i = i + i + is_less;
+        }
+        return j;
+    }
+
+    template<class T, class K, class C>
+    size_t eytzinger_lower_bound(T const* layout, size_t n, K const& k, C less)
+    {
+        return eytzinger_lower_bound(layout, n, k, less, detail::sort_identity{});
+    }
+
+    template<class T>
+    size_t eytzinger_lower_bound(T const* layout, size_t n, T k)
+    {
+        return eytzinger_lower_bound(layout, n, k, detail::sort_less{}, detail::sort_identity{});
+    }
+
+    namespace detail
+    {
+        // rotate [a, m) and [m, b), returns the new position of *a
+        template<class T>
+        T* rotate(T* a, T* m, T* b)
+        {
+            reverse(a, m);
+            reverse(m, b);
+            reverse(a, b);
+            return a + (b - m);
+        }
+
+        // stable merge of sorted [a, m) and [m, b), through the buffer when the smaller run fits, by rotations otherwise
+        template<class T, class C>
+        void merge(T* a, T* m, T* b, T* buffer, size_t capacity, C& less)
+        {
+            for (;;)
+            {
+                size_t n1 = m - a;
+                size_t n2 = b - m;
+                if (n1 == 0 || n2 == 0 || !less(*m, m[-1]))
+                    return;
+
+                if (n1 <= n2 && n1 <= capacity)
+                {
+                    // left run to the buffer and merge forward, ties take the left
+                    T* p = buffer;
+                    T* e = buffer;
+                    for (T* i = a; i < m; ++i)
+                        *e++ = move(*i);
+
+                    T* q = m;
+                    T* out = a;
+                    while (p < e && q < b)
+                        *out++ = less(*q, *p) ? move(*q++) : move(*p++);
+                    while (p < e)
+                        *out++ = move(*p++);
+                    return;
+                }
+
+                if (n2 <= capacity)
+                {
+                    // right run to the buffer and merge backward, ties take the right
+                    T* q = buffer;
+                    for (T* i = m; i < b; ++i)
+                        *q++ = move(*i);
+
+                    T* p = m;
+                    T* out = b;
+                    while (a < p && buffer < q)
+                        *--out = less(q[-1], p[-1]) ? move(*--p) : move(*--q);
+                    while (buffer < q)
+                        *--out = move(*--q);
+                    return;
+                }
+
+                if (n1 + n2 == 2)
+                    return swap(*a, *m);
+
+                // split the longer run in half, find where its middle goes in the other and rotate the pieces into place
+                T* cut1;
+                T* cut2;
+                if (n1 >= n2)
+                {
+                    cut1 = a + n1 / 2;
+                    cut2 = m + (ce::lower_bound(m, b, *cut1, less, sort_identity{}) - m);
+                }
+                else
+                {
+                    cut2 = m + n2 / 2;
+                    cut1 = a + (ce::upper_bound(a, m, *cut2, less, sort_identity{}) - a);
+                }
+
+                T* mid = rotate(cut1, m, cut2);
+                merge(a, cut1, mid, buffer, capacity, less);
+                a = mid;
+                m = cut2;
+            }
+        }
+
+        template<class T, class C>
+        void merge_sort(T* a, T* b, T* buffer, size_t capacity, C& less)
+        {
+            size_t n = b - a;
+            if (n < 16)
+                return insertion_sort(a, b, less);
+
+            T* m = a + n / 2;
+            merge_sort(a, m, buffer, capacity, less);
+            merge_sort(m, b, buffer, capacity, less);
+            merge(a, m, b, buffer, capacity, less);
+        }
+    }
+
+    // stable merge of the sorted adjacent runs [a, m) and [m, b), capacity elements of buffer are used as scratch,
+    // a buffer as large as the shorter run gives a single linear pass, anything less falls back to rotations
+    template<class T, class C>
+    void merge(T* a, T* m, T* b, T* buffer, size_t capacity, C less)
+    {
+        detail::merge(a, m, b, buffer, capacity, less);
+    }
+
+    template<class T>
+    void merge(T* a, T* m, T* b, T* buffer, size_t capacity)
+    {
+        merge(a, m, b, buffer, capacity, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void merge(T* a, T* m, T* b, T* buffer, size_t capacity, C less, P key)
+    {
+        merge(a, m, b, buffer, capacity, detail::sort_by<C, P>{ less, key });
+    }
+
+    // stable sort, n log n with a buffer of (b - a) / 2 elements, n log^2 n in place (capacity 0)
+    template<class T, class C>
+    void merge_sort(T* a, T* b, T* buffer, size_t capacity, C less)
+    {
+        detail::merge_sort(a, b, buffer, capacity, less);
+    }
+
+    template<class T>
+    void merge_sort(T* a, T* b, T* buffer, size_t capacity)
+    {
+        merge_sort(a, b, buffer, capacity, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void merge_sort(T* a, T* b, T* buffer, size_t capacity, C less, P key)
+    {
+        merge_sort(a, b, buffer, capacity, detail::sort_by<C, P>{ less, key });
+    }
+
+    namespace detail
+    {
+        template<class T, class C> struct merge_cursor
+        {
+            T const* p;
+            T const* e;
+            size_t run;
+            C const* less;
+
+            // earlier runs win ties so merging stable runs stays stable
+            bool operator<(merge_cursor const& other) const
+            {
+                return (*less)(*p, *other.p) || (!(*less)(*other.p, *p) && run < other.run);
+            }
+        };
+    }
+
+    // merges k <= K sorted runs into out in one streaming pass, returns the end of out
+    template<size_t K, class T, class C>
+    T* merge_n(size_t k, span<T const> const runs[], T* out, C less)
+    {
+        using cursor_t = detail::merge_cursor<T, C>;
+
+        CE_ASSERT(k <= K);
+        min_priority_queue<K, cursor_t> q{ };
+        for (size_t i = 0; i < k; ++i)
+            if (runs[i].size > 0)
+                q.enqueue({ runs[i].begin(), runs[i].end(), i, &less });
+
+        while (!q.empty())
+        {
+            cursor_t& c = q.data[0];
+            *out++ = *c.p;
+            if (++c.p < c.e)
+                heap_lower(q.size, q.data, c, 0);
+            else
+                q.dequeue();
+        }
+        return out;
+    }
+
+    template<size_t K, class T>
+    T* merge_n(size_t k, span<T const> const runs[], T* out)
+    {
+        return merge_n<K>(k, runs, out, detail::sort_less{});
+    }
+
+    template<size_t K, class T, class C, class P>
+    T* merge_n(size_t k, span<T const> const runs[], T* out, C less, P key)
+    {
+        return merge_n<K>(k, runs, out, detail::sort_by<C, P>{ less, key });
+    }
+
+    namespace detail
+    {
+        // leaves the m - a smallest of [a, b) in [a, m) as a max heap, n log (m - a)
+        template<class T, class C>
+        void heap_select(T* a, T* m, T* b, C& less)
+        {
+            auto greater = [&less](T const& x, T const& y) { return less(y, x); };
+
+            size_t k = m - a;
+            for (size_t i = k / 2; i-- > 0;)
+                heap_lower(k, a, move(a[i]), i, greater);
+
+            for (T* p = m; p < b; ++p)
+            {
+                if (less(*p, *a))
+                {
+                    T item = move(*p);
+                    *p = move(*a);
+                    heap_lower(k, a, move(item), 0, greater);
+                }
+            }
+        }
+    }
+
+    // reorders [a, b) so *nth is the element a full sort would put there, with nothing greater before it
+    // and nothing less after it, expected linear (introselect with the intro_sort pivot and partitions)
+    template<class T, class C>
+    void nth_element(T* a, T* nth, T* b, C less)
+    {
+        if (nth >= b)
+            return;
+
+        // same bad partition budget as intro_sort, then fall back to a heap select
+        size_t bad = 1;
+        for (size_t n = b - a; n > 1; n >>= 1)
+            ++bad;
+
+        bool leftmost = true;
+        while (b - a > 16)
+        {
+            size_t n = b - a;
+            detail::choose_pivot(a, b, less);
+
+            // pivot equals the one before this range, everything up to q is equal to it
+            if (!leftmost && !less(a[-1], *a))
+            {
+                T* q = detail::partition_left(a, b, less);
+                if (nth <= q)
+                    return;
+                a = q + 1;
+                continue;
+            }
+
+            bool sorted;
+            T* p = detail::partition_right(a, b, sorted, less);
+            if (p == nth)
+                return;
+
+            if ((size_t(p - a) < n / 8 || size_t(b - p - 1) < n / 8) && --bad == 0)
+            {
+                detail::heap_select(a, nth + 1, b, less);
+                return swap(*a, *nth);
+            }
+
+            if (nth < p)
+                b = p;
             else
-                n = step;
+            {
+                a = p + 1;
+                leftmost = false;
+            }
+        }
+        insertion_sort(a, b, less);
+    }
+
+    template<class T>
+    void nth_element(T* a, T* nth, T* b)
+    {
+        nth_element(a, nth, b, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void nth_element(T* a, T* nth, T* b, C less, P key)
+    {
+        nth_element(a, nth, b, detail::sort_by<C, P>{ less, key });
+    }
+
+    // sorts the m - a smallest elements of [a, b) into [a, m), the rest are left in unspecified order
+    template<class T, class C>
+    void partial_sort(T* a, T* m, T* b, C less)
+    {
+        if (a < m)
+        {
+            nth_element(a, m - 1, b, less);
+            intro_sort(a, m - 1, less);
         }
-        return a;
     }
+
+    template<class T>
+    void partial_sort(T* a, T* m, T* b)
+    {
+        partial_sort(a, m, b, detail::sort_less{});
+    }
+
+    template<class T, class C, class P>
+    void partial_sort(T* a, T* m, T* b, C less, P key)
+    {
+        partial_sort(a, m, b, detail::sort_by<C, P>{ less, key });
+    }
+
+    // streaming top K by less(key(a), key(b)), a min heap whose head is the smallest kept item so
+    // most pushes on a long stream cost a single compare
+    template<size_t K, class T, class C = detail::sort_less, class P = detail::sort_identity> struct top_k
+    {
+        min_priority_queue<K, T, detail::sort_by<C, P>> queue;
+
+        void reset(C less = C{ }, P key = P{ })
+        {
+            queue.size = 0;
+            queue.less = { less, key };
+        }
+
+        size_t size() const
+        {
+            return queue.size;
+        }
+
+        void push(T item)
+        {
+            if (queue.size < K)
+                queue.enqueue(move(item));
+            else if (queue.less(queue.data[0], item))
+                heap_lower(K, queue.data, move(item), 0, queue.less);
+        }
+
+        // moves the kept items out largest first and empties the accumulator, returns how many
+        size_t drain(T out[])
+        {
+            size_t n = queue.size;
+            for (size_t i = n; i > 0;)
+                out[--i] = queue.dequeue();
+            return n;
+        }
+    };
 }
@@ -24,6 +24,7 @@ SOFTWARE.
 */
 
 #include "ce.h"
+#include "sort.h"
 
 namespace ce
 {
@@ -75,18 +76,7 @@ namespace ce
 
     inline uint64_t const* z_lower_bound(uint64_t const* a, uint64_t const* b, uint64_t z)
     {
-        for (size_t n = b - a; n > 0;)
-        {
-            size_t step = n / 2;
-            uint64_t const* i = a + step;
-            if (*i < z) {
-                a = ++i;
-                n -= step + 1;
-            }
-            else
-                n = step;
-        }
-        return a;
+        return lower_bound(a, b, z);
     }
 
     inline bool z_inside(uint64_t lo, uint64_t hi, uint64_t zn)
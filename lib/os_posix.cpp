@@ -28,6 +28,7 @@ SOFTWARE.
 
 #include <unistd.h>
 #include <time.h>
+#include <sys/mman.h>
 
 namespace ce
 {
@@ -109,9 +110,26 @@ namespace ce
             return false;
         }
 
-        uint8_t* virtual_alloc(size_t)
+        uint8_t* virtual_alloc(size_t size)
         {
-            return nullptr;
+            auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return data == MAP_FAILED ? nullptr : static_cast<uint8_t*>(data);
+        }
+
+        uint8_t* virtual_reserve(size_t size)
+        {
+            auto data = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            return data == MAP_FAILED ? nullptr : static_cast<uint8_t*>(data);
+        }
+
+        bool virtual_commit(uint8_t* data, size_t size)
+        {
+            return mprotect(data, size, PROT_READ | PROT_WRITE) == 0;
+        }
+
+        bool virtual_free(uint8_t* data, size_t size)
+        {
+            return munmap(data, size) == 0;
         }
     }
 }
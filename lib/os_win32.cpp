@@ -172,6 +172,21 @@ namespace ce
         {
             return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
         }
+
+        uint8_t* virtual_reserve(size_t size)
+        {
+            return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+        }
+
+        bool virtual_commit(uint8_t* data, size_t size)
+        {
+            return VirtualAlloc(data, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+        }
+
+        bool virtual_free(uint8_t* data, size_t)
+        {
+            return VirtualFree(data, 0, MEM_RELEASE);
+        }
     }
 }
 #endif
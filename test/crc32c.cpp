@@ -0,0 +1,69 @@
+#include "ce/ce.h"
+
+#include "gtest/gtest.h"
+
+namespace
+{
+    uint8_t sample[3 * 4096 * 3 + 3 * 256 * 2 + 64];
+
+    void fill(size_t size, uint8_t data[])
+    {
+        ce::random::pcg32_64_t g;
+        seed(g, 0x0123456789ABCDEF);
+        for (size_t i = 0; i < size; ++i)
+            data[i] = uint8_t(next(g));
+    }
+}
+
+GTEST_TEST(crc32c, known)
+{
+    uint8_t digits[]{ '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    GTEST_EXPECT_TRUE(uint32_t(ce::crc32c(ce::crc32c_t::initial, sizeof(digits), digits)) == 0xe3069283);
+    GTEST_EXPECT_TRUE(ce::crc32c("123456789") == 0xe3069283);
+    GTEST_EXPECT_TRUE(ce::crc32c(ce::crc32c_t::initial, 0, digits) == ce::crc32c_t::initial);
+}
+
+GTEST_TEST(crc32c, table)
+{
+    fill(sizeof(sample), sample);
+
+    // every length through the short interleave, from unaligned starts
+    bool same = true;
+    for (size_t offset = 0; offset < 8; ++offset)
+        for (size_t n = 0; n < 3 * 256 * 2 + 16; ++n)
+            same = same && ce::crc32c(ce::crc32c_t::initial, n, sample + offset) == ce::crc32(ce::crc32c_t::initial, n, sample + offset);
+    GTEST_EXPECT_TRUE(same);
+
+    // long blocks, then short blocks, then the tail
+    for (size_t n : { size_t(3 * 4096), size_t(3 * 4096 * 2 + 3 * 256 + 13), sizeof(sample) - 1, sizeof(sample) })
+    {
+        auto a = ce::crc32c(ce::crc32c_t::initial, n, sample);
+        GTEST_EXPECT_TRUE(a == ce::crc32(ce::crc32c_t::initial, n, sample));
+
+        // continues from a previous crc like the table version
+        auto b = ce::crc32c(ce::crc32c(ce::crc32c_t::initial, n / 3, sample), n - n / 3, sample + n / 3);
+        GTEST_EXPECT_TRUE(a == b);
+    }
+}
+
+GTEST_TEST(crc32c, benchmark)
+{
+    if (ce::os::monotonic_frequency() == 0)
+        return;
+
+    static uint8_t data[1 << 24];
+    fill(sizeof(data), data);
+
+    auto a = ce::os::monotonic_timestamp();
+    auto x = ce::crc32(ce::crc32c_t::initial, sizeof(data), data);
+    auto b = ce::os::monotonic_timestamp();
+    auto y = ce::crc32c(ce::crc32c_t::initial, sizeof(data), data);
+    auto c = ce::os::monotonic_timestamp();
+
+    GTEST_EXPECT_TRUE(x == y);
+
+    double f = double(ce::os::monotonic_frequency());
+    auto table_mbs = sizeof(data) / ((b - a) / f) / 1e6;
+    auto crc32c_mbs = sizeof(data) / ((c - b) / f) / 1e6;
+    CE_LOG(crc32c, table_mbs, crc32c_mbs);
+}
@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
 struct index_t
 {
     int value;
@@ -29,3 +31,440 @@ GTEST_TEST(dictionary, test)
     GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("Sydney")].other_value == d[ce::hash::fnv1a("Jimmy")].other_value);
 }
 
+
+static uint32_t key_of(int i)
+{
+    char name[] = "name_000";
+    name[5] = char('0' + i / 100 % 10);
+    name[6] = char('0' + i / 10 % 10);
+    name[7] = char('0' + i % 10);
+    return ce::hash::fnv1a(name);
+}
+
+GTEST_TEST(dictionary, optimize)
+{
+    static hash_to_index d;
+    d = { };
+
+    for (int i = 0; i < 200; ++i)
+        d.bind(key_of(i), i, -i);
+
+    hash_to_index::ptr_t before[200];
+    hash_to_index::ptr_t remap[256];
+
+    for (int i = 0; i < 200; ++i)
+        before[i] = d.find(key_of(i));
+
+    d.optimize(remap);
+
+    GTEST_EXPECT_TRUE(d.heap == d.size);
+    GTEST_EXPECT_TRUE(d.size == 201);
+
+    // every node is between its children
+    for (size_t i = 1; i + i < d.heap; ++i)
+    {
+        GTEST_EXPECT_TRUE(d.names[i + i] < d.names[i]);
+        GTEST_EXPECT_TRUE(i + i + 1 >= d.heap || d.names[i] < d.names[i + i + 1]);
+    }
+
+    for (int i = 0; i < 200; ++i)
+    {
+        auto p = d.find(key_of(i));
+        GTEST_EXPECT_TRUE(p == remap[size_t(before[i])]);
+        GTEST_EXPECT_TRUE(d[p].value == i);
+        GTEST_EXPECT_TRUE(d[p].other_value == -i);
+    }
+
+    GTEST_EXPECT_TRUE(d.find(ce::hash::fnv1a("Mallori")) == hash_to_index::ptr_t::nil);
+
+    // names bound after optimize are still found
+    d.bind(ce::hash::fnv1a("Mallori"), 1, 2);
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("Mallori")].other_value == 2);
+    GTEST_EXPECT_TRUE(d[key_of(7)].value == 7);
+}
+
+GTEST_TEST(dictionary, optimize_large)
+{
+    // large enough that a capacity sized array on the stack would not fit
+    using big_t = ce::dictionary<1 << 16, index_t, uint32_t>;
+    static big_t d;
+    static big_t::ptr_t before[60000];
+    static big_t::ptr_t remap[1 << 16];
+    d = { };
+
+    for (int i = 0; i < 60000; ++i)
+        before[i] = d.bind(key_of(i) ^ uint32_t(i / 1000) << 24, i, -i);
+
+    for (int i = 0; i < 60000; i += 7)
+        d.erase(before[i]);
+
+    d.optimize(remap);
+
+    GTEST_EXPECT_TRUE(d.size == d.heap);
+    GTEST_EXPECT_TRUE(d.size == 1 + 60000 - 8572);
+
+    bool ordered = true;
+    for (size_t i = 1; i + i < d.heap; ++i)
+        ordered = ordered && d.names[i + i] < d.names[i] && (i + i + 1 >= d.heap || d.names[i] < d.names[i + i + 1]);
+    GTEST_EXPECT_TRUE(ordered);
+
+    bool found = true;
+    for (int i = 0; i < 60000; ++i)
+    {
+        auto p = d.find(key_of(i) ^ uint32_t(i / 1000) << 24);
+        if (i % 7 == 0)
+            found = found && p == big_t::ptr_t::nil && remap[size_t(before[i])] == big_t::ptr_t::nil;
+        else
+            found = found && p == remap[size_t(before[i])] && d[p].value == i;
+    }
+    GTEST_EXPECT_TRUE(found);
+}
+
+GTEST_TEST(dictionary, erase)
+{
+    static hash_to_index d;
+    d = { };
+
+    for (int i = 0; i < 100; ++i)
+        d.bind(key_of(i), i, -i);
+
+    d.optimize();
+
+    for (int i = 100; i < 200; ++i)
+        d.bind(key_of(i), i, -i);
+
+    // erase every third name, both in the search tree and the unordered tail
+    for (int i = 0; i < 200; i += 3)
+        GTEST_EXPECT_TRUE(d.erase(key_of(i)));
+
+    GTEST_EXPECT_TRUE(!d.erase(key_of(0)));
+    GTEST_EXPECT_TRUE(d.erased == 67);
+
+    for (int i = 0; i < 200; ++i)
+        GTEST_EXPECT_TRUE((d.find(key_of(i)) == hash_to_index::ptr_t::nil) == (i % 3 == 0));
+
+    // rebinding revives the tombstone
+    auto p = d.bind(key_of(3), 33, 0);
+    GTEST_EXPECT_TRUE(p == d.find(key_of(3)));
+    GTEST_EXPECT_TRUE(d[p].value == 33);
+    GTEST_EXPECT_TRUE(d.erased == 66);
+
+    // a little work each "frame", keeping held ptr_t's up to date from the reported moves
+    hash_to_index::ptr_t held[200];
+    for (int i = 0; i < 200; ++i)
+        held[i] = d.find(key_of(i));
+
+    size_t frames = 0;
+    size_t total = 0;
+    for (size_t left = d.erased; left > 0; ++frames)
+    {
+        hash_to_index::move_t moves[16];
+        size_t moved;
+        left = d.compact(16, moves, moved);
+        total += moved;
+
+        for (size_t m = 0; m < moved; ++m)
+            for (auto& h : held)
+                if (h == moves[m].from)
+                    h = moves[m].to;
+    }
+
+    GTEST_EXPECT_TRUE(frames > 1);
+    GTEST_EXPECT_TRUE(total > 0);
+    for (int i = 0; i < 200; ++i)
+        GTEST_EXPECT_TRUE(held[i] == d.find(key_of(i)));
+    // only the 33 tombstones past the search tree are reclaimed, the 33 inside it wait for optimize
+    GTEST_EXPECT_TRUE(d.size == 201 - 33);
+    GTEST_EXPECT_TRUE(d.heap == 101);
+    GTEST_EXPECT_TRUE(d.erased == 33 && d.buried == 33);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        auto q = d.find(key_of(i));
+        if (i == 3)
+            GTEST_EXPECT_TRUE(d[q].value == 33);
+        else if (i % 3 == 0)
+            GTEST_EXPECT_TRUE(q == hash_to_index::ptr_t::nil);
+        else
+            GTEST_EXPECT_TRUE(d[q].value == i);
+    }
+
+    // reclaimed slots can be bound again
+    for (int i = 200; i < 250; ++i)
+        GTEST_EXPECT_TRUE(d.bind(key_of(i), i, -i) != hash_to_index::ptr_t::nil);
+
+    d.erase(key_of(200));
+    d.optimize();
+    GTEST_EXPECT_TRUE(d.erased == 0);
+    GTEST_EXPECT_TRUE(d.size == d.heap);
+    GTEST_EXPECT_TRUE(d.find(key_of(200)) == hash_to_index::ptr_t::nil);
+    GTEST_EXPECT_TRUE(d[key_of(201)].value == 201);
+    GTEST_EXPECT_TRUE(d[key_of(199)].value == 199);
+}
+
+GTEST_TEST(dictionary, compact_tree)
+{
+    using big_t = ce::dictionary<4096, index_t, uint32_t>;
+    static big_t d;
+    d = { };
+
+    for (int i = 0; i < 4000; ++i)
+        d.bind(key_of(i) ^ uint32_t(i / 1000) << 24, i, -i);
+    d.optimize();
+
+    // erase the root and a name bound after the tree, compact must leave the tree whole
+    auto root = d.names[1];
+    GTEST_EXPECT_TRUE(d.erase(root));
+    d.bind(ce::hash::fnv1a("Mallori"), -1, 1);
+    d.bind(ce::hash::fnv1a("Jimmy"), -2, 2);
+    GTEST_EXPECT_TRUE(d.erase(ce::hash::fnv1a("Mallori")));
+
+    while (d.compact(16) > 0)
+        ;
+
+    GTEST_EXPECT_TRUE(d.heap == 4001);
+    GTEST_EXPECT_TRUE(d.size == 4002);
+    GTEST_EXPECT_TRUE(d.erased == 1 && d.buried == 1);
+
+    bool found = true;
+    for (int i = 0; i < 4000; ++i)
+    {
+        auto n = key_of(i) ^ uint32_t(i / 1000) << 24;
+        auto p = d.find(n);
+        found = found && (n == root ? p == big_t::ptr_t::nil : p != big_t::ptr_t::nil && size_t(p) < d.heap && d[p].value == i);
+    }
+    GTEST_EXPECT_TRUE(found);
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("Jimmy")].value == -2);
+    GTEST_EXPECT_TRUE(d.find(ce::hash::fnv1a("Mallori")) == big_t::ptr_t::nil);
+
+    // optimize reclaims the one in the tree
+    d.optimize();
+    GTEST_EXPECT_TRUE(d.erased == 0 && d.buried == 0 && d.size == 4001 && d.heap == 4001);
+}
+
+GTEST_TEST(dictionary, concurrent)
+{
+    static ce::concurrent_dictionary<256, index_t, uint32_t> d;
+    d.reset();
+
+    static ce::atomic<int> done;
+    ce::atomic_store(done, 0);
+
+    // readers must only ever see fully written pairs
+    auto reader = []
+    {
+        int torn = 0;
+        while (ce::atomic_load(done) == 0)
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                index_t v;
+                if (d.read(key_of(i), v))
+                    torn += v.value != -v.other_value;
+            }
+        }
+        return torn;
+    };
+
+    int torn[4]{ };
+    std::thread readers[4];
+    for (int i = 0; i < 4; ++i)
+        readers[i] = std::thread([&torn, i, reader] { torn[i] = reader(); });
+
+    for (int pass = 0; pass < 20; ++pass)
+        for (int i = 0; i < 200; ++i)
+            d.bind(key_of(i), i + pass, -(i + pass));
+
+    ce::atomic_store(done, 1);
+
+    for (auto& t : readers)
+        t.join();
+
+    for (auto t : torn)
+        GTEST_EXPECT_TRUE(t == 0);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        index_t v;
+        GTEST_EXPECT_TRUE(d.read(key_of(i), v));
+        GTEST_EXPECT_TRUE(v.value == i + 19);
+    }
+
+    GTEST_EXPECT_TRUE(d.find(ce::hash::fnv1a("Mallori")) == decltype(d)::ptr_t::nil);
+
+    d.destroy();
+
+    // reset clears versions left odd by whatever was there before, or read would spin forever
+    ce::atomic_store(d.versions[1], 7);
+    d.reset();
+    d.bind(key_of(0), 1, -1);
+    index_t v;
+    GTEST_EXPECT_TRUE(d.read(key_of(0), v) && v.value == 1);
+    d.destroy();
+}
+
+GTEST_TEST(dictionary, concurrent_optimize)
+{
+    static ce::concurrent_dictionary<512, index_t, uint32_t> d;
+    d.reset();
+
+    for (int i = 0; i < 300; ++i)
+        d.bind(key_of(i), i, -i);
+    d.optimize();
+    GTEST_EXPECT_TRUE(ce::atomic_load(d.heap) == 301);
+
+    static ce::atomic<int> done;
+    ce::atomic_store(done, 0);
+
+    // readers descend the tree while a writer rebinds tree names and adds new ones past it
+    auto reader = []
+    {
+        int bad = 0;
+        while (ce::atomic_load(done) == 0)
+        {
+            for (int i = 0; i < 400; ++i)
+            {
+                index_t v;
+                auto p = d.find(key_of(i));
+                if (i < 300)
+                    bad += p == decltype(d)::ptr_t::nil || size_t(p) > 300;
+                if (d.read(p, v))
+                    bad += v.value != -v.other_value || v.value % 1000 != i;
+            }
+        }
+        return bad;
+    };
+
+    int bad[2]{ };
+    std::thread readers[2];
+    for (int i = 0; i < 2; ++i)
+        readers[i] = std::thread([&bad, i, reader] { bad[i] = reader(); });
+
+    for (int pass = 0; pass < 10; ++pass)
+        for (int i = 0; i < 400; ++i)
+            d.bind(key_of(i), i + pass * 1000, -(i + pass * 1000));
+
+    ce::atomic_store(done, 1);
+
+    for (auto& t : readers)
+        t.join();
+
+    for (auto b : bad)
+        GTEST_EXPECT_TRUE(b == 0);
+
+    GTEST_EXPECT_TRUE(ce::atomic_load(d.size) == 401);
+    GTEST_EXPECT_TRUE(ce::atomic_load(d.heap) == 301);
+
+    // optimizing again pulls the later names into the tree
+    d.optimize();
+    GTEST_EXPECT_TRUE(ce::atomic_load(d.heap) == 401);
+    bool found = true;
+    for (int i = 0; i < 400; ++i)
+    {
+        index_t v;
+        found = found && d.read(key_of(i), v) && v.value == i + 9000;
+    }
+    GTEST_EXPECT_TRUE(found);
+    GTEST_EXPECT_TRUE(d.find(ce::hash::fnv1a("Mallori")) == decltype(d)::ptr_t::nil);
+
+    d.destroy();
+}
+
+GTEST_TEST(dictionary, perfect)
+{
+    using names = ce::items<uint32_t,
+        ce::hash::fnv1a("width"), ce::hash::fnv1a("height"), ce::hash::fnv1a("depth"), ce::hash::fnv1a("format"),
+        ce::hash::fnv1a("mips"), ce::hash::fnv1a("layers"), ce::hash::fnv1a("samples"), ce::hash::fnv1a("usage"),
+        ce::hash::fnv1a("Mallori"), ce::hash::fnv1a("Jimmy"), ce::hash::fnv1a("Sydney")>;
+
+    using config = ce::perfect_dictionary<index_t, names>;
+
+    CE_STATIC_ASSERT(config::capacity >= 11 && config::capacity <= 11 + 11 / 4 + 1);
+    CE_STATIC_ASSERT(config::find(ce::hash::fnv1a("width")) != config::ptr_t::nil);
+    CE_STATIC_ASSERT(config::find(ce::hash::fnv1a("wisth")) == config::ptr_t::nil);
+
+    config d{ };
+
+    d[ce::hash::fnv1a("width")] = { 640, 1 };
+    d[ce::hash::fnv1a("height")] = { 480, 2 };
+    d[ce::hash::fnv1a("Sydney")] = { 7, 3 };
+
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("width")].value == 640);
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("height")].value == 480);
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("Sydney")].other_value == 3);
+    GTEST_EXPECT_TRUE(d[ce::hash::fnv1a("mips")].value == 0);
+
+    // every name has its own slot
+    bool used[config::capacity + 1]{ };
+    for (auto n : { ce::hash::fnv1a("width"), ce::hash::fnv1a("height"), ce::hash::fnv1a("depth"), ce::hash::fnv1a("format"),
+        ce::hash::fnv1a("mips"), ce::hash::fnv1a("layers"), ce::hash::fnv1a("samples"), ce::hash::fnv1a("usage"),
+        ce::hash::fnv1a("Mallori"), ce::hash::fnv1a("Jimmy"), ce::hash::fnv1a("Sydney") })
+    {
+        auto p = size_t(config::find(n));
+        GTEST_EXPECT_TRUE(p != 0 && !used[p]);
+        used[p] = true;
+    }
+
+    GTEST_EXPECT_TRUE(config::find(ce::hash::fnv1a("Mallory")) == config::ptr_t::nil);
+}
+
+namespace
+{
+    constexpr uint32_t many_key(size_t i) { return uint32_t(i) * 2654435761u ^ 0x5bd1e995; }
+
+    template<class> struct many_names;
+    template<size_t...Is> struct many_names<ce::items<size_t, Is...>> { using type = ce::items<uint32_t, many_key(Is)...>; };
+}
+
+GTEST_TEST(dictionary, perfect_large)
+{
+    using config = ce::perfect_dictionary<int, typename many_names<ce::sequence_t<size_t, 2000>>::type>;
+
+    CE_STATIC_ASSERT(config::capacity <= 2000 + 2000 / 4 + 1);
+
+    bool found = true;
+    static bool used[config::capacity + 1];
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        auto p = size_t(config::find(many_key(i)));
+        found = found && p != 0 && !used[p];
+        used[p] = true;
+    }
+    GTEST_EXPECT_TRUE(found);
+
+    bool missing = true;
+    for (size_t i = 2000; i < 4000; ++i)
+        missing = missing && config::find(many_key(i)) == config::ptr_t::nil;
+    GTEST_EXPECT_TRUE(missing);
+}
+
+GTEST_TEST(dictionary, find_n)
+{
+    static hash_to_index d;
+    d = { };
+
+    for (int i = 0; i < 150; ++i)
+        d.bind(key_of(i), i, -i);
+
+    d.optimize();
+
+    for (int i = 150; i < 200; ++i)
+        d.bind(key_of(i), i, -i);
+
+    d.erase(key_of(10));
+    d.erase(key_of(160));
+
+    // names in the tree, the unordered tail, erased and never bound
+    uint32_t keys[250];
+    for (int i = 0; i < 250; ++i)
+        keys[i] = key_of((i * 7) % 250);
+
+    hash_to_index::ptr_t ptrs[250];
+    d.find_n(250, keys, ptrs);
+
+    for (int i = 0; i < 250; ++i)
+        GTEST_EXPECT_TRUE(ptrs[i] == d.find(keys[i]));
+
+    GTEST_EXPECT_TRUE(ptrs[10 * 143 % 250] == hash_to_index::ptr_t::nil);
+    GTEST_EXPECT_TRUE(d[ptrs[1]].value == 7);
+}
@@ -2,7 +2,483 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
+namespace
+{
+    // mix of text like repeats, runs and noise
+    void fill_sample(size_t size, uint8_t data[], uint64_t seed_value)
+    {
+        ce::random::pcg32_64_t g;
+        seed(g, seed_value);
+
+        char const* words[]{ "lziii ", "span ", "literal ", "control ", "window ", "\n" };
+        for (size_t i = 0; i < size;)
+        {
+            uint32_t r = next_unbiased(g, 10);
+            if (r < 6)
+            {
+                for (char const* w = words[r]; *w && i < size; ++w)
+                    data[i++] = uint8_t(*w);
+            }
+            else if (r < 8)
+            {
+                uint8_t b = uint8_t(next(g));
+                for (uint32_t n = next_unbiased(g, 40); n > 0 && i < size; --n)
+                    data[i++] = b;
+            }
+            else
+            {
+                for (uint32_t n = next_unbiased(g, 20); n > 0 && i < size; --n)
+                    data[i++] = uint8_t(next(g));
+            }
+        }
+    }
+
+    bool round_trip(size_t size, uint8_t const data[], size_t effort, size_t* encoded_size = nullptr)
+    {
+        static uint8_t encoded[ce::lziii::encode_bound(100000)];
+        static uint8_t decoded[100000];
+
+        size_t n = ce::lziii::encode(size, data, encoded, effort);
+        if (encoded_size)
+            *encoded_size = n;
+
+        if (n > ce::lziii::encode_bound(size) || ce::lziii::size(n, encoded) != size)
+            return false;
+
+        ce::lziii::decode(size, decoded, encoded);
+        for (size_t i = 0; i < size; ++i)
+            if (decoded[i] != data[i])
+                return false;
+
+        // the checked decoder with an exact fit and with room to spare
+        for (size_t capacity : { size, sizeof(decoded) })
+        {
+            CE_MEMSET(decoded, 0, sizeof(decoded));
+            if (ce::lziii::decode_checked(n, encoded, capacity, decoded) != size)
+                return false;
+            for (size_t i = 0; i < size; ++i)
+                if (decoded[i] != data[i])
+                    return false;
+        }
+        return true;
+    }
+}
+
 GTEST_TEST(lziii, lziii)
 {
+    static uint8_t data[100000];
+    fill_sample(sizeof(data), data, 0x0123456789ABCDEF);
+
+    for (size_t size : { size_t(0), size_t(1), size_t(2), size_t(3), size_t(8), size_t(9), size_t(4097), size_t(100000) })
+        for (size_t effort = 0; effort <= 4; ++effort)
+            GTEST_EXPECT_TRUE(round_trip(size, data, effort));
+}
+
+GTEST_TEST(lziii, encode)
+{
+    static uint8_t data[100000];
+
+    // incompressible data only costs the control bytes
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+    for (auto& b : data) b = uint8_t(next(g));
+    size_t n = 0;
+    GTEST_EXPECT_TRUE(round_trip(sizeof(data), data, 2, &n));
+    GTEST_EXPECT_TRUE(n <= ce::lziii::encode_bound(sizeof(data)));
+
+    // a single repeated byte is all max length spans
+    for (auto& b : data) b = 7;
+    GTEST_EXPECT_TRUE(round_trip(sizeof(data), data, 0, &n));
+    GTEST_EXPECT_TRUE(n < sizeof(data) / 8);
+
+    // more effort never loses much and usually wins
+    fill_sample(sizeof(data), data, 0x0123456789ABCDEF);
+    size_t fast = 0;
+    size_t best = 0;
+    GTEST_EXPECT_TRUE(round_trip(sizeof(data), data, 0, &fast));
+    GTEST_EXPECT_TRUE(round_trip(sizeof(data), data, 4, &best));
+    GTEST_EXPECT_TRUE(best < fast);
+    GTEST_EXPECT_TRUE(best < sizeof(data) / 2);
+}
+
+namespace
+{
+    CE_LZIII_TEXT(banner, "ce ce ce ce ce - constexpr compression, constexpr decompression, constexpr everything ce ce ce");
+
+    constexpr ce::lziii::encoder<banner> packed;
+    constexpr ce::lziii::decoder<ce::lziii::encoder<banner>> unpacked;
+
+    constexpr bool same_as_banner()
+    {
+        banner b{ };
+        if (unpacked.size != b.size)
+            return false;
+        for (size_t i = 0; i < b.size; ++i)
+            if (unpacked.data[i] != uint8_t(b.data[i]))
+                return false;
+        return true;
+    }
+
+    CE_STATIC_ASSERT(packed.size < banner{ }.size);
+    CE_STATIC_ASSERT(same_as_banner());
+
+    // a few KB table, the default effort keeps it well inside tight constexpr step limits (e.g. -fconstexpr-ops-limit=1048576)
+    CE_LZIII_TEXT(ascii_table,
+        "dec  hex   oct  chr name\n"
+        "  0  0x00  000  nul null\n"
+        "  1  0x01  001  soh start of heading\n"
+        "  2  0x02  002  stx start of text\n"
+        "  3  0x03  003  etx end of text\n"
+        "  4  0x04  004  eot end of transmission\n"
+        "  5  0x05  005  enq enquiry\n"
+        "  6  0x06  006  ack acknowledge\n"
+        "  7  0x07  007  bel bell\n"
+        "  8  0x08  010  bs  backspace\n"
+        "  9  0x09  011  ht  horizontal tab\n"
+        " 10  0x0a  012  lf  line feed\n"
+        " 11  0x0b  013  vt  vertical tab\n"
+        " 12  0x0c  014  ff  form feed\n"
+        " 13  0x0d  015  cr  carriage return\n"
+        " 14  0x0e  016  so  shift out\n"
+        " 15  0x0f  017  si  shift in\n"
+        " 16  0x10  020  dle data link escape\n"
+        " 17  0x11  021  dc1 device control one\n"
+        " 18  0x12  022  dc2 device control two\n"
+        " 19  0x13  023  dc3 device control three\n"
+        " 20  0x14  024  dc4 device control four\n"
+        " 21  0x15  025  nak negative acknowledge\n"
+        " 22  0x16  026  syn synchronous idle\n"
+        " 23  0x17  027  etb end of transmission block\n"
+        " 24  0x18  030  can cancel\n"
+        " 25  0x19  031  em  end of medium\n"
+        " 26  0x1a  032  sub substitute\n"
+        " 27  0x1b  033  esc escape\n"
+        " 28  0x1c  034  fs  file separator\n"
+        " 29  0x1d  035  gs  group separator\n"
+        " 30  0x1e  036  rs  record separator\n"
+        " 31  0x1f  037  us  unit separator\n"
+        " 32  0x20  040  sp  space\n"
+        " 33  0x21  041  !   exclamation mark\n"
+        " 34  0x22  042  \"   quotation mark\n"
+        " 35  0x23  043  #   number sign\n"
+        " 36  0x24  044  $   dollar sign\n"
+        " 37  0x25  045  %   percent sign\n"
+        " 38  0x26  046  &   ampersand\n"
+        " 39  0x27  047  '   apostrophe\n"
+        " 40  0x28  050  (   left parenthesis\n"
+        " 41  0x29  051  )   right parenthesis\n"
+        " 42  0x2a  052  *   asterisk\n"
+        " 43  0x2b  053  +   plus sign\n"
+        " 44  0x2c  054  ,   comma\n"
+        " 45  0x2d  055  -   hyphen-minus\n"
+        " 46  0x2e  056  .   full stop\n"
+        " 47  0x2f  057  /   solidus\n"
+        " 48  0x30  060  0   digit zero\n"
+        " 49  0x31  061  1   digit one\n"
+        " 50  0x32  062  2   digit two\n"
+        " 51  0x33  063  3   digit three\n"
+        " 52  0x34  064  4   digit four\n"
+        " 53  0x35  065  5   digit five\n"
+        " 54  0x36  066  6   digit six\n"
+        " 55  0x37  067  7   digit seven\n"
+        " 56  0x38  070  8   digit eight\n"
+        " 57  0x39  071  9   digit nine\n"
+        " 58  0x3a  072  :   colon\n"
+        " 59  0x3b  073  ;   semicolon\n"
+        " 60  0x3c  074  <   less-than sign\n"
+        " 61  0x3d  075  =   equals sign\n"
+        " 62  0x3e  076  >   greater-than sign\n"
+        " 63  0x3f  077  ?   question mark\n"
+        " 64  0x40  100  @   commercial at\n"
+        " 65  0x41  101  A   latin capital letter a\n"
+        " 66  0x42  102  B   latin capital letter b\n"
+        " 67  0x43  103  C   latin capital letter c\n"
+        " 68  0x44  104  D   latin capital letter d\n"
+        " 69  0x45  105  E   latin capital letter e\n"
+        " 70  0x46  106  F   latin capital letter f\n"
+        " 71  0x47  107  G   latin capital letter g\n"
+        " 72  0x48  110  H   latin capital letter h\n"
+        " 73  0x49  111  I   latin capital letter i\n"
+        " 74  0x4a  112  J   latin capital letter j\n"
+        " 75  0x4b  113  K   latin capital letter k\n"
+        " 76  0x4c  114  L   latin capital letter l\n"
+        " 77  0x4d  115  M   latin capital letter m\n"
+        " 78  0x4e  116  N   latin capital letter n\n"
+        " 79  0x4f  117  O   latin capital letter o\n"
+        " 80  0x50  120  P   latin capital letter p\n"
+        " 81  0x51  121  Q   latin capital letter q\n"
+        " 82  0x52  122  R   latin capital letter r\n"
+        " 83  0x53  123  S   latin capital letter s\n"
+        " 84  0x54  124  T   latin capital letter t\n"
+        " 85  0x55  125  U   latin capital letter u\n"
+        " 86  0x56  126  V   latin capital letter v\n"
+        " 87  0x57  127  W   latin capital letter w\n"
+        " 88  0x58  130  X   latin capital letter x\n"
+        " 89  0x59  131  Y   latin capital letter y\n"
+        " 90  0x5a  132  Z   latin capital letter z\n"
+        " 91  0x5b  133  [   left square bracket\n"
+        " 92  0x5c  134  \\   reverse solidus\n"
+        " 93  0x5d  135  ]   right square bracket\n"
+        " 94  0x5e  136  ^   circumflex accent\n"
+        " 95  0x5f  137  _   low line\n"
+        " 96  0x60  140  `   grave accent\n"
+        " 97  0x61  141  a   latin small letter a\n"
+        " 98  0x62  142  b   latin small letter b\n"
+        " 99  0x63  143  c   latin small letter c\n"
+        "100  0x64  144  d   latin small letter d\n"
+        "101  0x65  145  e   latin small letter e\n"
+        "102  0x66  146  f   latin small letter f\n"
+        "103  0x67  147  g   latin small letter g\n"
+        "104  0x68  150  h   latin small letter h\n"
+        "105  0x69  151  i   latin small letter i\n"
+        "106  0x6a  152  j   latin small letter j\n"
+        "107  0x6b  153  k   latin small letter k\n"
+        "108  0x6c  154  l   latin small letter l\n"
+        "109  0x6d  155  m   latin small letter m\n"
+        "110  0x6e  156  n   latin small letter n\n"
+        "111  0x6f  157  o   latin small letter o\n"
+        "112  0x70  160  p   latin small letter p\n"
+        "113  0x71  161  q   latin small letter q\n"
+        "114  0x72  162  r   latin small letter r\n"
+        "115  0x73  163  s   latin small letter s\n"
+        "116  0x74  164  t   latin small letter t\n"
+        "117  0x75  165  u   latin small letter u\n"
+        "118  0x76  166  v   latin small letter v\n"
+        "119  0x77  167  w   latin small letter w\n"
+        "120  0x78  170  x   latin small letter x\n"
+        "121  0x79  171  y   latin small letter y\n"
+        "122  0x7a  172  z   latin small letter z\n"
+        "123  0x7b  173  {   left curly bracket\n"
+        "124  0x7c  174  |   vertical line\n"
+        "125  0x7d  175  }   right curly bracket\n"
+        "126  0x7e  176  ~   tilde\n"
+        "127  0x7f  177  del delete\n");
+
+    constexpr ce::lziii::encoder<ascii_table> packed_table;
+    constexpr ce::lziii::decoder<ce::lziii::encoder<ascii_table>> unpacked_table;
+
+    constexpr bool same_as_table()
+    {
+        ascii_table t{ };
+        if (unpacked_table.size != t.size)
+            return false;
+        for (size_t i = 0; i < t.size; ++i)
+            if (unpacked_table.data[i] != uint8_t(t.data[i]))
+                return false;
+        return true;
+    }
+
+    CE_STATIC_ASSERT(ascii_table{ }.size > 4096);
+    CE_STATIC_ASSERT(packed_table.size < ascii_table{ }.size);
+    CE_STATIC_ASSERT(same_as_table());
+}
+
+GTEST_TEST(lziii, encoder)
+{
+    // the compile time encoder matches the runtime one
+    banner b{ };
+    uint8_t encoded[ce::lziii::encode_bound(banner{ }.size)];
+    size_t n = ce::lziii::encode(b.size, b.data, encoded, 1);
+    GTEST_EXPECT_TRUE(n == packed.size);
+    for (size_t i = 0; i < n; ++i)
+        GTEST_EXPECT_TRUE(encoded[i] == packed.data[i]);
+
+    static uint8_t table[ce::lziii::encode_bound(ascii_table{ }.size)];
+    ascii_table t{ };
+    n = ce::lziii::encode(t.size, t.data, table, 1);
+    GTEST_EXPECT_TRUE(n == packed_table.size);
+    bool same = true;
+    for (size_t i = 0; i < n; ++i)
+        same = same && table[i] == packed_table.data[i];
+    GTEST_EXPECT_TRUE(same);
+}
+
+GTEST_TEST(lziii, decode_checked)
+{
+    static uint8_t data[10000];
+    static uint8_t encoded[ce::lziii::encode_bound(10000)];
+    static uint8_t decoded[10000];
+
+    fill_sample(sizeof(data), data, 0xABCDEF0123456789);
+    size_t n = ce::lziii::encode(sizeof(data), data, encoded);
+
+    // every truncation either decodes a prefix or is rejected, never overruns
+    for (size_t i = 0; i < n; i += 7)
+    {
+        size_t m = ce::lziii::decode_checked(i, encoded, sizeof(decoded), decoded);
+        GTEST_EXPECT_TRUE(m == ce::lziii::decode_error || m <= sizeof(data));
+    }
+
+    // too small a destination
+    GTEST_EXPECT_TRUE(ce::lziii::decode_checked(n, encoded, sizeof(data) - 1, decoded) == ce::lziii::decode_error);
+
+    // a span before the start
+    uint8_t bad[]{ 0x00, 0xff, 0x0f };
+    GTEST_EXPECT_TRUE(ce::lziii::decode_checked(sizeof(bad), bad, sizeof(decoded), decoded) == ce::lziii::decode_error);
+
+    // a control byte with nothing after it
+    uint8_t dangling[]{ 0xff, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 0x01 };
+    GTEST_EXPECT_TRUE(ce::lziii::decode_checked(sizeof(dangling), dangling, sizeof(decoded), decoded) == ce::lziii::decode_error);
+    GTEST_EXPECT_TRUE(ce::lziii::decode_checked(sizeof(dangling) - 1, dangling, sizeof(decoded), decoded) == 8);
+
+    // random garbage
+    ce::random::pcg32_64_t g;
+    seed(g, 0x0123456789ABCDEF);
+    for (int round = 0; round < 100; ++round)
+    {
+        for (auto& b : encoded) b = uint8_t(next(g));
+        size_t m = ce::lziii::decode_checked(next_unbiased(g, sizeof(encoded)), encoded, sizeof(decoded), decoded);
+        GTEST_EXPECT_TRUE(m == ce::lziii::decode_error || m <= sizeof(decoded));
+    }
+}
+
+GTEST_TEST(lziii, benchmark)
+{
+    if (ce::os::monotonic_frequency() == 0)
+        return;
+
+    static uint8_t data[1 << 22];
+    static uint8_t encoded[ce::lziii::encode_bound(1 << 22)];
+    static uint8_t decoded[1 << 22];
+
+    fill_sample(sizeof(data), data, 0x0123456789ABCDEF);
+    size_t n = ce::lziii::encode(sizeof(data), data, encoded);
+
+    auto a = ce::os::monotonic_timestamp();
+    ce::lziii::decode(sizeof(decoded), decoded, encoded);
+    auto b = ce::os::monotonic_timestamp();
+    size_t m = ce::lziii::decode_checked(n, encoded, sizeof(decoded), decoded);
+    auto c = ce::os::monotonic_timestamp();
+
+    GTEST_EXPECT_TRUE(m == sizeof(data));
+
+    double f = double(ce::os::monotonic_frequency());
+    auto decode_mbs = sizeof(data) / ((b - a) / f) / 1e6;
+    auto checked_mbs = sizeof(data) / ((c - b) / f) / 1e6;
+    CE_LOG(lziii, decode_mbs, checked_mbs);
+}
+
+GTEST_TEST(lziii, stream_decoder)
+{
+    static uint8_t data[50000];
+    static uint8_t encoded[ce::lziii::encode_bound(50000)];
+    static uint8_t decoded[50000];
+    static ce::lziii::stream_decoder stream;
+
+    fill_sample(sizeof(data), data, 0x0123456789ABCDEF);
+    size_t n = ce::lziii::encode(sizeof(data), data, encoded);
+
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+
+    for (int round = 0; round < 4; ++round)
+    {
+        // decode through a small output buffer that is reused every drain, as a ring of buffers would be
+        uint8_t buffer[97];
+        size_t in_chunk = round == 0 ? 1 : 1 + next_unbiased(g, 5000);
+        size_t out_chunk = round == 1 ? 1 : 1 + next_unbiased(g, sizeof(buffer) - 1);
+
+        stream.reset();
+        size_t o = 0;
+        for (size_t s = 0; s < n; s += in_chunk)
+        {
+            stream.feed(s + in_chunk < n ? in_chunk : n - s, encoded + s);
+            for (size_t m; (m = stream.drain(out_chunk, buffer)) > 0; o += m)
+                CE_MEMCPY(decoded + o, buffer, m);
+        }
+
+        GTEST_EXPECT_TRUE(stream.complete());
+        GTEST_EXPECT_TRUE(o == sizeof(data));
+        bool same = true;
+        for (size_t i = 0; i < sizeof(data); ++i)
+            same = same && decoded[i] == data[i];
+        GTEST_EXPECT_TRUE(same);
+    }
+
+    // a span before the start stops the stream
+    uint8_t bad[]{ 0x00, 0xff, 0x0f };
+    stream.reset();
+    stream.feed(sizeof(bad), bad);
+    GTEST_EXPECT_TRUE(stream.drain(sizeof(decoded), decoded) == 0);
+    GTEST_EXPECT_TRUE(stream.error && !stream.complete());
+
+    // stopping between the two bytes of a span is not complete
+    uint8_t half[]{ 0x01, 'a', 0xff };
+    stream.reset();
+    stream.feed(sizeof(half), half);
+    GTEST_EXPECT_TRUE(stream.drain(sizeof(decoded), decoded) == 1);
+    GTEST_EXPECT_TRUE(!stream.error && !stream.complete());
+}
+
+GTEST_TEST(lziii, frame)
+{
+    constexpr size_t size = 600000;
+    constexpr size_t block_size = 65536;
+    static uint8_t data[size];
+    static uint8_t framed[ce::lziii::frame_bound(size, block_size)];
+    static uint8_t decoded[size];
+
+    fill_sample(size, data, 0x0F1E2D3C4B5A6978);
+    size_t n = ce::lziii::frame_encode(size, data, framed, block_size);
+    GTEST_EXPECT_TRUE(n <= sizeof(framed));
+
+    ce::lziii::frame f;
+    GTEST_EXPECT_TRUE(f.open(n, framed));
+    GTEST_EXPECT_TRUE(f.block_count == 10 && f.decoded_size == size);
+    GTEST_EXPECT_TRUE(f.decode(decoded) == size);
+
+    bool same = true;
+    for (size_t i = 0; i < size; ++i)
+        same = same && decoded[i] == data[i];
+    GTEST_EXPECT_TRUE(same);
+
+    // blocks split across threads
+    CE_MEMSET(decoded, 0, sizeof(decoded));
+    bool ok[4]{ };
+    std::thread threads[4];
+    for (size_t t = 0; t < 4; ++t)
+        threads[t] = std::thread([&f, &ok, t]
+        {
+            ok[t] = true;
+            for (size_t i = t; i < f.block_count; i += 4)
+                ok[t] = ok[t] && f.decode_block(i, decoded + i * f.block_size) != ce::lziii::decode_error;
+        });
+    for (auto& t : threads)
+        t.join();
+
+    same = ok[0] && ok[1] && ok[2] && ok[3];
+    for (size_t i = 0; i < size; ++i)
+        same = same && decoded[i] == data[i];
+    GTEST_EXPECT_TRUE(same);
+
+    // random access to the short last block
+    uint8_t last[block_size];
+    GTEST_EXPECT_TRUE(f.decode_block(9, last) == size - 9 * block_size);
+    same = true;
+    for (size_t i = 0; i < size - 9 * block_size; ++i)
+        same = same && last[i] == data[9 * block_size + i];
+    GTEST_EXPECT_TRUE(same);
+
+    // a flipped byte fails that block only
+    ce::lziii::frame_block b = f.block(3);
+    framed[b.offset + b.encoded_size / 2] ^= 0x20;
+    GTEST_EXPECT_TRUE(f.decode_block(3, decoded) == ce::lziii::decode_error);
+    GTEST_EXPECT_TRUE(f.decode_block(4, decoded) == block_size);
+    framed[b.offset + b.encoded_size / 2] ^= 0x20;
+
+    // malformed headers and index
+    GTEST_EXPECT_TRUE(!f.open(n - 1, framed));
+    GTEST_EXPECT_TRUE(!f.open(ce::lziii::frame_header_size + 9 * ce::lziii::frame_entry_size, framed));
+    framed[0] ^= 1;
+    GTEST_EXPECT_TRUE(!f.open(n, framed) && f.block_count == 0);
+    framed[0] ^= 1;
+    framed[ce::lziii::frame_header_size + 12] ^= 1;
+    GTEST_EXPECT_TRUE(!f.open(n, framed));
+    framed[ce::lziii::frame_header_size + 12] ^= 1;
 
-}
\ No newline at end of file
+    // an empty frame is just the header
+    GTEST_EXPECT_TRUE(ce::lziii::frame_encode(0, data, framed, block_size) == ce::lziii::frame_header_size);
+    GTEST_EXPECT_TRUE(f.open(ce::lziii::frame_header_size, framed) && f.block_count == 0 && f.decode(decoded) == 0);
+}
@@ -12,6 +12,7 @@
 #include "ce/math.h"
 #include "ce/mutex.h"
 #include "ce/nameof.h"
+#include "ce/parallel_sort.h"
 #include "ce/pool.h"
 #include "ce/sort.h"
 #include "ce/zorder.h"
@@ -415,4 +416,24 @@ GTEST_TEST(ce, monotonic_timestamp)
         CE_LOG(info, cf, t, m);
         ce::os::sleep_ns(100000000);
     } while (m * 2 < f);
-}
\ No newline at end of file
+}
+
+GTEST_TEST(ce, bitset_find_next)
+{
+    ce::bitset<200> b;
+    b.reset();
+
+    GTEST_EXPECT_TRUE(b.find_next(0) == 200);
+
+    b.set(0);
+    b.set(63);
+    b.set(64);
+    b.set(199);
+
+    GTEST_EXPECT_TRUE(b.find_next(0) == 0);
+    GTEST_EXPECT_TRUE(b.find_next(1) == 63);
+    GTEST_EXPECT_TRUE(b.find_next(64) == 64);
+    GTEST_EXPECT_TRUE(b.find_next(65) == 199);
+    GTEST_EXPECT_TRUE(b.find_next(199) == 199);
+    GTEST_EXPECT_TRUE(b.find_next(200) == 200);
+}
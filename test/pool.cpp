@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
 GTEST_TEST(pool, append_tail)
 {
     using pool = ce::pool<1024, int>;
@@ -54,4 +56,314 @@ GTEST_TEST(pool, insert_head)
     p.remove_head(q);
     GTEST_EXPECT_TRUE(p.head(q) == 2);
     p.remove_head(q);
-}
\ No newline at end of file
+}
+
+GTEST_TEST(pool, concurrent)
+{
+    using pool = ce::concurrent_pool<1024, int>;
+    static pool p;
+    static ce::atomic<int> owned[1024];
+
+    p.reset();
+
+    // every thread holds up to 64 nodes at a time, no node may ever be handed out twice
+    auto worker = [](int id, bool use_magazine)
+    {
+        int failures = 0;
+        pool::magazine_t m{ };
+        uint16_t held[64];
+
+        for (int pass = 0; pass < 2000; ++pass)
+        {
+            for (auto& node : held)
+            {
+                node = use_magazine ? p.alloc_index(m) : p.alloc_index();
+                failures += node == 0 || ce::atomic_exchange(owned[node], 1) != 0;
+                p.data[node] = id;
+            }
+
+            for (auto node : held)
+            {
+                failures += p.data[node] != id;
+                ce::atomic_store(owned[node], 0);
+                if (use_magazine)
+                    p.free_index(m, node);
+                else
+                    p.free_index(node);
+            }
+        }
+
+        p.flush(m);
+        return failures;
+    };
+
+    int failures[8]{ };
+    std::thread threads[8];
+    for (int i = 0; i < 8; ++i)
+        threads[i] = std::thread([&failures, i, worker] { failures[i] = worker(i + 1, i % 2 == 0); });
+
+    for (auto& t : threads)
+        t.join();
+
+    for (auto f : failures)
+        GTEST_EXPECT_TRUE(f == 0);
+
+    // 8 * 64 nodes were live at most, every free node is on the free list
+    size_t free = 0;
+    for (size_t i = ce::atomic_load(p.free_head) & pool::index_mask; i != 0; i = ce::atomic_load(p.next[i]))
+        ++free;
+
+    GTEST_EXPECT_TRUE(free == ce::atomic_load(p.size));
+    GTEST_EXPECT_TRUE(ce::atomic_load(p.size) <= 8 * (64 + 32));
+}
+
+GTEST_TEST(pool, mpsc_queue)
+{
+    using pool = ce::concurrent_pool<1024, uint32_t>;
+    static pool p;
+    static pool::mpsc_queue_t q;
+
+    p.reset();
+    GTEST_EXPECT_TRUE(p.reset(q));
+
+    uint32_t item = 0;
+    GTEST_EXPECT_TRUE(!p.remove_head(q, item));
+
+    constexpr uint32_t count = 20000;
+
+    std::thread producers[4];
+    for (uint32_t i = 0; i < 4; ++i)
+        producers[i] = std::thread([i]
+        {
+            for (uint32_t n = 0; n < count; ++n)
+                while (!p.append_tail(q, i << 24 | n))
+                    std::this_thread::yield();
+        });
+
+    // each producer's items arrive in order
+    uint32_t expect[4]{ };
+    bool ordered = true;
+    for (uint32_t received = 0; received < 4 * count;)
+    {
+        if (p.remove_head(q, item))
+        {
+            ordered &= (item & 0xffffff) == expect[item >> 24]++;
+            ++received;
+        }
+        else
+            std::this_thread::yield();
+    }
+
+    for (auto& t : producers)
+        t.join();
+
+    GTEST_EXPECT_TRUE(ordered);
+    GTEST_EXPECT_TRUE(!p.remove_head(q, item));
+}
+
+GTEST_TEST(pool, spsc_ring)
+{
+    static ce::spsc_ring<64> r;
+    r.reset();
+
+    uint16_t item = 0;
+    GTEST_EXPECT_TRUE(!r.remove_head(item));
+
+    for (uint16_t i = 0; i < 64; ++i)
+        GTEST_EXPECT_TRUE(r.append_tail(i));
+    GTEST_EXPECT_TRUE(!r.append_tail(64));
+    GTEST_EXPECT_TRUE(r.remove_head(item) && item == 0);
+
+    r.reset();
+
+    std::thread producer([]
+    {
+        for (uint32_t n = 0; n < 100000; ++n)
+            while (!r.append_tail(uint16_t(n)))
+                std::this_thread::yield();
+    });
+
+    bool ordered = true;
+    for (uint32_t n = 0; n < 100000;)
+    {
+        if (r.remove_head(item))
+            ordered &= item == uint16_t(n++);
+        else
+            std::this_thread::yield();
+    }
+
+    producer.join();
+
+    GTEST_EXPECT_TRUE(ordered);
+}
+
+GTEST_TEST(pool, chunked_pool)
+{
+    struct particle { float x, y, z, t; };
+
+    using pool = ce::chunked_pool<1 << 22, particle>;
+    pool p{ };
+
+    GTEST_EXPECT_TRUE(p.reserve());
+    p.reset();
+
+    // only the first chunk is committed
+    GTEST_EXPECT_TRUE(p.committed < 10000);
+
+    auto first = p.alloc_index();
+    auto address = &p[first];
+    p[first] = { 1, 2, 3, 4 };
+
+    bool sequential = true;
+    for (uint32_t i = 2; i <= 100000; ++i)
+    {
+        auto node = p.alloc_index();
+        sequential &= node == i;
+        p[node] = { float(i), 0, 0, 0 };
+    }
+
+    GTEST_EXPECT_TRUE(sequential);
+    GTEST_EXPECT_TRUE(p.committed > 100000 && p.committed < 200000);
+
+    // growing never moves anything
+    GTEST_EXPECT_TRUE(&p[first] == address);
+    GTEST_EXPECT_TRUE(p[first].t == 4);
+    GTEST_EXPECT_TRUE(p[99999].x == 99999);
+
+    p.free_index(500);
+    GTEST_EXPECT_TRUE(p.alloc_index() == 500);
+    GTEST_EXPECT_TRUE(p.alloc_index() == 100001);
+
+    p.release();
+    GTEST_EXPECT_TRUE(p.data == nullptr);
+}
+
+GTEST_TEST(pool, generational_pool)
+{
+    using pool = ce::generational_pool<1024, int>;
+    static pool p;
+
+    p.reset();
+
+    GTEST_EXPECT_TRUE(!p.is_valid(pool::nil));
+    GTEST_EXPECT_TRUE(p.get(pool::nil) == nullptr);
+
+    auto a = p.alloc();
+    auto b = p.alloc();
+    *p.get(a) = 1;
+    *p.get(b) = 2;
+
+    GTEST_EXPECT_TRUE(p.is_valid(a) && p.is_valid(b));
+    GTEST_EXPECT_TRUE(*p.get(a) == 1);
+
+    GTEST_EXPECT_TRUE(p.free(a));
+    GTEST_EXPECT_TRUE(!p.free(a));
+    GTEST_EXPECT_TRUE(!p.is_valid(a));
+    GTEST_EXPECT_TRUE(p.get(a) == nullptr);
+
+    // the node is reused, but the old handle stays stale
+    auto c = p.alloc();
+    GTEST_EXPECT_TRUE(pool::index_of(c) == pool::index_of(a));
+    GTEST_EXPECT_TRUE(c != a);
+    GTEST_EXPECT_TRUE(!p.is_valid(a));
+    GTEST_EXPECT_TRUE(p.is_valid(c));
+    GTEST_EXPECT_TRUE(*p.get(b) == 2);
+
+    // a handle to a node never handed out is invalid
+    GTEST_EXPECT_TRUE(!p.is_valid(pool::handle_t(100)));
+}
+
+GTEST_TEST(pool, soa_pool)
+{
+    using pool = ce::soa_pool<256, ce::types<float, float, int>>;
+    static pool p;
+
+    p.reset();
+
+    uint16_t ids[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        auto id = p.alloc_index();
+        ids[i] = id;
+        p.get<0>(id) = float(i);
+        p.get<1>(id) = 1.0f;
+        p.get<2>(id) = i;
+    }
+
+    GTEST_EXPECT_TRUE(p.size == 100);
+
+    // free the even ones, the fields stay dense
+    for (int i = 0; i < 100; i += 2)
+        GTEST_EXPECT_TRUE(p.free_index(ids[i]));
+
+    GTEST_EXPECT_TRUE(!p.free_index(ids[0]));
+    GTEST_EXPECT_TRUE(p.size == 50);
+
+    float ones = 0;
+    for (auto x : p.field_span<1>())
+        ones += x;
+    GTEST_EXPECT_TRUE(ones == 50);
+
+    int odd = 0;
+    for (auto n : p.field_span<2>())
+        odd += n % 2;
+    GTEST_EXPECT_TRUE(odd == 50);
+
+    // ids are stable even though the fields moved
+    for (int i = 1; i < 100; i += 2)
+    {
+        GTEST_EXPECT_TRUE(p.is_live(ids[i]));
+        GTEST_EXPECT_TRUE(p.get<0>(ids[i]) == float(i));
+        GTEST_EXPECT_TRUE(p.get<2>(ids[i]) == i);
+    }
+
+    // freed ids are reused before fresh ones
+    auto id = p.alloc_index();
+    GTEST_EXPECT_TRUE(p.is_live(id));
+    GTEST_EXPECT_TRUE(p.fresh == 100);
+    GTEST_EXPECT_TRUE(p.size == 51);
+}
+
+GTEST_TEST(pool, live)
+{
+    using pool = ce::pool<1024, int>;
+    static pool p;
+
+    p.reset();
+
+    GTEST_EXPECT_TRUE(p.next_live(0) == 0);
+
+    for (int i = 1; i <= 300; ++i)
+        p.data[p.alloc_index()] = i;
+
+    // free everything but multiples of 7, across several 64 bit words
+    for (uint16_t i = 1; i <= 300; ++i)
+        if (i % 7 != 0)
+            p.free_index(i);
+
+    int count = 0;
+    int sum = 0;
+    bool multiples = true;
+    p.for_each_live([&](uint16_t i, int& n)
+    {
+        ++count;
+        sum += n;
+        multiples &= i % 7 == 0;
+    });
+
+    GTEST_EXPECT_TRUE(count == 300 / 7);
+    GTEST_EXPECT_TRUE(sum == 7 * (42 * 43 / 2));
+    GTEST_EXPECT_TRUE(multiples);
+
+    GTEST_EXPECT_TRUE(p.next_live(0) == 7);
+    GTEST_EXPECT_TRUE(p.next_live(7) == 14);
+    GTEST_EXPECT_TRUE(p.next_live(294) == 0);
+
+    // nodes removed from a queue are no longer live
+    pool::queue_t q{ };
+    p.append_tail(q, 1000);
+    auto node = uint16_t(q.tail);
+    GTEST_EXPECT_TRUE(p.live[node]);
+    p.remove_head(q);
+    GTEST_EXPECT_TRUE(!p.live[node]);
+}
@@ -1,7 +1,10 @@
 #include "ce/sort.h"
+#include "ce/parallel_sort.h"
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
 GTEST_TEST(sort, intro_sort)
 {
     int a[]{ 10, 2, 6, 2, 5, 7, 4, 9, 12, 10 };
@@ -42,6 +45,37 @@ GTEST_TEST(sort, intro_sort)
     }
 }
 
+GTEST_TEST(sort, intro_sort_partitions)
+{
+    // more than the 64 a sorting network takes, with the smallest cutoff so partitioning goes all the way down
+    // and then with the default cutoff of 24 so partitions end in insertion_sort
+    static int a[1000];
+    ce::random::pcg32_64_t g;
+    seed(g, 0x1234);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        int64_t sum = 0;
+        for (auto& x : a)
+            sum += x = int(next_unbiased(g, 300));
+
+        if (pass == 0)
+            ce::intro_sort<4>(a, a + CE_COUNTOF(a));
+        else
+            ce::intro_sort(a, a + CE_COUNTOF(a));
+
+        bool sorted = true;
+        int64_t after = 0;
+        for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+        {
+            sorted = sorted && (i == 0 || a[i - 1] <= a[i]);
+            after += a[i];
+        }
+        GTEST_EXPECT_TRUE(sorted);
+        GTEST_EXPECT_TRUE(sum == after);
+    }
+}
+
 GTEST_TEST(sort, insertion_sort)
 {
     int b[]{ 10, 2, 6, 2, 5, 7, 4, 9, 12, 10 };
@@ -69,4 +103,609 @@ GTEST_TEST(sort, random)
         EXPECT_GE(n, z);
         z = n;
     }
-}
\ No newline at end of file
+}
+namespace
+{
+    struct record
+    {
+        uint32_t key;
+        uint32_t tag;
+        bool operator<(record const& other) const { return key < other.key; }
+    };
+
+    uint32_t key_of(uint32_t n) { return n; }
+    uint32_t key_of(record const& r) { return r.key; }
+
+    void set_key(uint32_t& n, uint32_t k, size_t) { n = k; }
+    void set_key(record& r, uint32_t k, size_t i) { r = { k, uint32_t(i) }; }
+
+    bool same(uint32_t a, uint32_t b) { return a == b; }
+    bool same(record const& a, record const& b) { return a.key == b.key && a.tag == b.tag; }
+
+    template<class T> void fill_pattern(T* a, size_t n, int pattern, ce::random::pcg32_64_t& g)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint32_t k = 0;
+            switch (pattern)
+            {
+            case 0: k = uint32_t(i); break; // sorted
+            case 1: k = uint32_t(n - i); break; // reversed
+            case 2: k = 7; break; // all equal
+            case 3: k = next_unbiased(g, 4); break; // few unique
+            case 4: k = uint32_t(i < n / 2 ? i : n - i); break; // organ pipe
+            case 5: k = uint32_t(i * 16 + next_unbiased(g, 64)); break; // sorted with noise
+            case 6: k = uint32_t(i % 64); break; // sawtooth
+            default: k = next(g); break;
+            }
+            set_key(a[i], k, i);
+        }
+    }
+
+    template<class T> uint64_t key_sum(T const* a, size_t n)
+    {
+        uint64_t s = 0;
+        for (size_t i = 0; i < n; ++i)
+            s += key_of(a[i]) * uint64_t(key_of(a[i]) ^ 0x9e3779b9);
+        return s;
+    }
+
+    template<class T> bool is_sorted(T const* a, size_t n)
+    {
+        for (size_t i = 1; i < n; ++i)
+            if (a[i] < a[i - 1])
+                return false;
+        return true;
+    }
+
+    template<class T> void check_patterns()
+    {
+        ce::random::pcg32_64_t g;
+        seed(g, 0x0123456789ABCDEF);
+
+        static T a[10000];
+        static T b[10000];
+        for (size_t n : { size_t(0), size_t(1), size_t(3), size_t(24), size_t(100), size_t(129), size_t(1000), size_t(10000) })
+        {
+            for (int pattern = 0; pattern < 8; ++pattern)
+            {
+                fill_pattern(a, n, pattern, g);
+                uint64_t s = key_sum(a, n);
+                for (size_t i = 0; i < n; ++i)
+                    b[i] = a[i];
+
+                ce::intro_sort(a, a + n);
+                GTEST_EXPECT_TRUE(is_sorted(a, n));
+                GTEST_EXPECT_TRUE(key_sum(a, n) == s);
+
+                // small cutoff so short ranges go through partitioning too
+                ce::intro_sort<4>(b, b + n);
+                GTEST_EXPECT_TRUE(is_sorted(b, n));
+                GTEST_EXPECT_TRUE(key_sum(b, n) == s);
+            }
+        }
+    }
+}
+
+GTEST_TEST(sort, patterns)
+{
+    // uint32_t takes the branchless block partition, record the plain one
+    check_patterns<uint32_t>();
+    check_patterns<record>();
+}
+
+GTEST_TEST(sort, heap_sort)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+
+    uint32_t a[1000];
+    for (auto& n : a) n = next_unbiased(g, 100);
+    uint64_t s = key_sum(a, CE_COUNTOF(a));
+
+    ce::heap_sort(a, a + CE_COUNTOF(a));
+    GTEST_EXPECT_TRUE(is_sorted(a, CE_COUNTOF(a)));
+    GTEST_EXPECT_TRUE(key_sum(a, CE_COUNTOF(a)) == s);
+
+    ce::heap_sort(a, a + CE_COUNTOF(a), [](uint32_t x, uint32_t y) { return y < x; });
+    for (size_t i = 1; i < CE_COUNTOF(a); ++i)
+        GTEST_EXPECT_TRUE(a[i] <= a[i - 1]);
+}
+
+GTEST_TEST(sort, partition)
+{
+    int a[]{ 10, 2, 6, 2, 5, 7, 4, 9, 12, 10 };
+    int* p = ce::partition(a, a + CE_COUNTOF(a));
+    for (int* q = a; q < p; ++q)
+        GTEST_EXPECT_TRUE(*q < *p);
+    for (int* q = p + 1; q < a + CE_COUNTOF(a); ++q)
+        GTEST_EXPECT_TRUE(!(*q < *p));
+}
+
+namespace
+{
+    // sorting must never need a copy
+    struct move_only
+    {
+        uint32_t key;
+        uint32_t* payload;
+
+        move_only() = default;
+        move_only(move_only const&) = delete;
+        move_only& operator=(move_only const&) = delete;
+        move_only(move_only&& other) : key(other.key), payload(other.payload) { other.payload = nullptr; }
+        move_only& operator=(move_only&& other) { key = other.key; payload = other.payload; other.payload = nullptr; return *this; }
+    };
+}
+
+GTEST_TEST(sort, comparator)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0x0123456789ABCDEF);
+
+    static uint32_t a[5000];
+    for (auto& n : a) n = next_unbiased(g, 1000);
+
+    auto greater = [](uint32_t x, uint32_t y) { return y < x; };
+    ce::intro_sort(a, a + CE_COUNTOF(a), greater);
+    for (size_t i = 1; i < CE_COUNTOF(a); ++i)
+        GTEST_EXPECT_TRUE(a[i] <= a[i - 1]);
+
+    // bounds take the same comparator the range was sorted with
+    uint32_t const* lo = ce::lower_bound(a, a + CE_COUNTOF(a), 500u, greater);
+    uint32_t const* hi = ce::upper_bound(a, a + CE_COUNTOF(a), 500u, greater);
+    GTEST_EXPECT_TRUE(lo == a || lo[-1] > 500);
+    GTEST_EXPECT_TRUE(hi == a + CE_COUNTOF(a) || *hi < 500);
+    for (auto p = lo; p < hi; ++p)
+        GTEST_EXPECT_TRUE(*p == 500);
+}
+
+GTEST_TEST(sort, projection)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+
+    static uint32_t payload[3000];
+    static move_only a[3000];
+    for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+    {
+        payload[i] = next_unbiased(g, 300);
+        a[i].key = payload[i];
+        a[i].payload = &payload[i];
+    }
+
+    auto key = [](move_only const& m) { return m.key; };
+    auto less = [](uint32_t x, uint32_t y) { return x < y; };
+
+    ce::intro_sort(a, a + CE_COUNTOF(a), less, key);
+    for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+    {
+        GTEST_EXPECT_TRUE(a[i].payload != nullptr && *a[i].payload == a[i].key);
+        GTEST_EXPECT_TRUE(i == 0 || a[i - 1].key <= a[i].key);
+    }
+
+    move_only const* lo = ce::lower_bound(a, a + CE_COUNTOF(a), 150u, less, key);
+    move_only const* hi = ce::upper_bound(a, a + CE_COUNTOF(a), 150u, less, key);
+    GTEST_EXPECT_TRUE(lo == a || lo[-1].key < 150);
+    GTEST_EXPECT_TRUE(hi == a + CE_COUNTOF(a) || hi->key > 150);
+    for (auto p = lo; p < hi; ++p)
+        GTEST_EXPECT_TRUE(p->key == 150);
+
+    // insertion_sort, heap_sort and partition all take the same extra arguments
+    auto greater = [](uint32_t x, uint32_t y) { return y < x; };
+    ce::heap_sort(a, a + CE_COUNTOF(a), greater, key);
+    for (size_t i = 1; i < CE_COUNTOF(a); ++i)
+        GTEST_EXPECT_TRUE(a[i - 1].key >= a[i].key);
+
+    ce::insertion_sort(a, a + 100, less, key);
+    for (size_t i = 1; i < 100; ++i)
+        GTEST_EXPECT_TRUE(a[i - 1].key <= a[i].key);
+
+    move_only* p = ce::partition(a, a + CE_COUNTOF(a), less, key);
+    for (auto q = a; q < p; ++q)
+        GTEST_EXPECT_TRUE(q->key < p->key);
+    for (auto q = p + 1; q < a + CE_COUNTOF(a); ++q)
+        GTEST_EXPECT_TRUE(q->key >= p->key);
+}
+
+namespace
+{
+    // the stack histogram overloads only take up to 11 bit digits
+    template<size_t D, class T, class...Ps> void radix_sort_with(uint32_t* counts, T* a, T* b, T* scratch, Ps*...ps)
+    {
+        if constexpr (D <= 11)
+            if (counts == nullptr)
+                return ce::radix_sort<D>(a, b, scratch, ps...);
+        ce::radix_sort<D>(a, b, scratch, ps..., counts);
+    }
+
+    template<size_t D, class T> void check_radix(T (*make)(uint32_t, uint32_t), uint32_t* counts = nullptr)
+    {
+        ce::random::pcg32_64_t g;
+        seed(g, 0x0123456789ABCDEF);
+
+        static T a[3000];
+        static T b[3000];
+        static T scratch[3000];
+        static uint32_t payload[3000];
+        static uint32_t payload_scratch[3000];
+
+        for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+        {
+            a[i] = make(next(g), next(g));
+            b[i] = a[i];
+            payload[i] = uint32_t(i);
+        }
+
+        radix_sort_with<D>(counts, a, a + CE_COUNTOF(a), scratch);
+        ce::intro_sort(b, b + CE_COUNTOF(b));
+        for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+            GTEST_EXPECT_TRUE(ce::detail::radix_key(a[i]) == ce::detail::radix_key(b[i]));
+
+        // payload follows its key and equal keys keep their order
+        for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+            a[i] = make(next(g), next(g) & 3), b[i] = a[i];
+        radix_sort_with<D>(counts, a, a + CE_COUNTOF(a), scratch, payload, payload_scratch);
+        for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+        {
+            GTEST_EXPECT_TRUE(ce::detail::radix_key(b[payload[i]]) == ce::detail::radix_key(a[i]));
+            GTEST_EXPECT_TRUE(i == 0 || !(a[i] < a[i - 1]));
+            GTEST_EXPECT_TRUE(i == 0 || a[i - 1] < a[i] || payload[i - 1] < payload[i]);
+        }
+    }
+}
+
+GTEST_TEST(sort, radix_sort)
+{
+    auto u8 = [](uint32_t x, uint32_t) { return uint8_t(x); };
+    auto i16 = [](uint32_t x, uint32_t) { return int16_t(x); };
+    auto u32 = [](uint32_t x, uint32_t y) { return y < 2 ? x & 0xff00ff : x; };
+    auto i32 = [](uint32_t x, uint32_t) { return int32_t(x); };
+    auto u64 = [](uint32_t x, uint32_t y) { return uint64_t(x) << 32 | y; };
+    auto i64 = [](uint32_t x, uint32_t y) { return int64_t(uint64_t(x) << 32 | y); };
+    auto f32 = [](uint32_t x, uint32_t y) { return (float(x) - 2147483648.0f) / float(y | 1); };
+    auto f64 = [](uint32_t x, uint32_t y) { return (double(x) - 2147483648.0) * double(y | 1); };
+
+    check_radix<8>(+u8);
+    check_radix<8>(+i16);
+    check_radix<8>(+u32);
+    check_radix<11>(+u32);
+    check_radix<10>(+u32);
+    check_radix<11>(+i32);
+    check_radix<8>(+u64);
+    check_radix<11>(+i64);
+    check_radix<10>(+i64);
+    check_radix<8>(+f32);
+    check_radix<11>(+f32);
+    check_radix<11>(+f64);
+
+    // wider digits with the histogram outside the stack
+    static uint32_t counts[1 << 16];
+    check_radix<16>(+u32, counts);
+    check_radix<16>(+i64, counts);
+    check_radix<13>(+f32, counts);
+    check_radix<8>(+u64, counts);
+
+    // all keys equal means every pass is skipped
+    uint32_t a[100];
+    uint32_t scratch[100];
+    for (auto& n : a) n = 42;
+    ce::radix_sort(a, a + CE_COUNTOF(a), scratch);
+    for (auto n : a)
+        GTEST_EXPECT_TRUE(n == 42);
+}
+
+namespace
+{
+    template<class T> void check_parallel_sort()
+    {
+        static ce::parallel_sort<8, T> sorter;
+        static T a[100000];
+        static T b[100000];
+        static T c[100000];
+
+        ce::random::pcg32_64_t g;
+        seed(g, 0x0123456789ABCDEF);
+
+        for (int pattern = 0; pattern < 8; ++pattern)
+        {
+            fill_pattern(a, CE_COUNTOF(a), pattern, g);
+            uint64_t s = key_sum(a, CE_COUNTOF(a));
+
+            for (size_t threads : { 1, 3, 8 })
+            {
+                for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+                    c[i] = a[i];
+
+                sorter.reset(c, c + CE_COUNTOF(c), threads, { }, 1000);
+
+                std::thread helpers[7];
+                for (size_t i = 1; i < threads; ++i)
+                    helpers[i - 1] = std::thread([i] { sorter.run(i); });
+                sorter.run(0);
+                for (size_t i = 1; i < threads; ++i)
+                    helpers[i - 1].join();
+
+                GTEST_EXPECT_TRUE(is_sorted(c, CE_COUNTOF(c)));
+                GTEST_EXPECT_TRUE(key_sum(c, CE_COUNTOF(c)) == s);
+
+                // equal keys land in the same order whatever the thread count
+                if (threads == 1)
+                {
+                    for (size_t i = 0; i < CE_COUNTOF(c); ++i)
+                        b[i] = c[i];
+                }
+                else
+                {
+                    bool same = true;
+                    for (size_t i = 0; i < CE_COUNTOF(c); ++i)
+                        same &= ::same(b[i], c[i]);
+                    GTEST_EXPECT_TRUE(same);
+                }
+            }
+        }
+    }
+}
+
+GTEST_TEST(sort, parallel_sort)
+{
+    check_parallel_sort<uint32_t>();
+    check_parallel_sort<record>();
+}
+
+namespace
+{
+    template<class T> void check_network(T (*make)(uint32_t))
+    {
+        ce::random::pcg32_64_t g;
+        seed(g, 0xABCDEF0123456789);
+
+        for (size_t n = 0; n <= 64; ++n)
+        {
+            for (int round = 0; round < 8; ++round)
+            {
+                T a[64];
+                T b[64];
+                for (size_t i = 0; i < n; ++i)
+                    a[i] = b[i] = make(round < 4 ? next(g) : next_unbiased(g, 4));
+
+                ce::detail::network_sort(a, n);
+                ce::insertion_sort(b, b + n);
+                for (size_t i = 0; i < n; ++i)
+                    GTEST_EXPECT_TRUE(ce::detail::radix_key(a[i]) == ce::detail::radix_key(b[i]));
+            }
+        }
+
+        // the lanes built in, and the avx2 ones picked at run time, whichever network_sort used above
+        for (size_t k : { 8, 16, 32, 64 })
+        {
+            T a[64];
+            T b[64];
+            T c[64];
+            for (size_t i = 0; i < k; ++i)
+                a[i] = b[i] = c[i] = make(next(g));
+
+            ce::detail::network_sort_k<ce::detail::network_lanes<sizeof(T), ce::detail::network_kind<T>>>(a, k);
+#if CE_SORT_AVX2_DISPATCH
+            if (ce::detail::network_has_avx2())
+                ce::detail::network_sort_avx2(c, k);
+            else
+                ce::insertion_sort(c, c + k);
+#else
+            ce::insertion_sort(c, c + k);
+#endif
+            ce::insertion_sort(b, b + k);
+            for (size_t i = 0; i < k; ++i)
+            {
+                GTEST_EXPECT_TRUE(ce::detail::radix_key(a[i]) == ce::detail::radix_key(b[i]));
+                GTEST_EXPECT_TRUE(ce::detail::radix_key(c[i]) == ce::detail::radix_key(b[i]));
+            }
+        }
+    }
+}
+
+GTEST_TEST(sort, network)
+{
+    check_network<uint32_t>([](uint32_t x) { return x; });
+    check_network<int32_t>([](uint32_t x) { return int32_t(x); });
+    check_network<float>([](uint32_t x) { return float(int32_t(x)) / 7.0f; });
+    check_network<uint64_t>([](uint32_t x) { return uint64_t(x) << 31 ^ x; });
+    check_network<int64_t>([](uint32_t x) { return int64_t(uint64_t(x) << 32 | x); });
+    check_network<double>([](uint32_t x) { return double(int32_t(x)) * 1e-3; });
+
+    // -0.0 and +0.0 compare equal but must both survive
+    float z[]{ 0.0f, -0.0f, 0.0f, -0.0f, 1.0f, -1.0f, -0.0f };
+    ce::intro_sort(z, z + CE_COUNTOF(z));
+    int negative = 0;
+    for (auto f : z)
+        negative += ce::detail::radix_key(f) == ce::detail::radix_key(-0.0f);
+    GTEST_EXPECT_TRUE(negative == 3);
+    GTEST_EXPECT_TRUE(z[0] == -1.0f && z[6] == 1.0f);
+}
+
+GTEST_TEST(sort, bounds)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0x0123456789ABCDEF);
+
+    static uint32_t a[1000];
+    static uint32_t layout[1001];
+    static uint32_t keys[300];
+    static uint32_t const* found[300];
+
+    for (size_t n : { size_t(0), size_t(1), size_t(2), size_t(7), size_t(64), size_t(1000) })
+    {
+        for (size_t i = 0; i < n; ++i)
+            a[i] = next_unbiased(g, 500) * 2;
+        ce::intro_sort(a, a + n);
+        ce::eytzinger_layout(a, a + n, layout);
+
+        for (size_t i = 0; i < CE_COUNTOF(keys); ++i)
+            keys[i] = next_unbiased(g, 1002);
+        ce::lower_bound_n(a, a + n, CE_COUNTOF(keys), keys, found);
+
+        for (size_t i = 0; i < CE_COUNTOF(keys); ++i)
+        {
+            uint32_t k = keys[i];
+
+            // reference linear scans
+            size_t lo = 0;
+            while (lo < n && a[lo] < k) ++lo;
+            size_t hi = lo;
+            while (hi < n && !(k < a[hi])) ++hi;
+
+            GTEST_EXPECT_TRUE(ce::lower_bound(a, a + n, k) == a + lo);
+            GTEST_EXPECT_TRUE(ce::upper_bound(a, a + n, k) == a + hi);
+            GTEST_EXPECT_TRUE(found[i] == a + lo);
+
+            size_t e = ce::eytzinger_lower_bound(layout, n, k);
+            GTEST_EXPECT_TRUE(lo == n ? e == 0 : e != 0 && layout[e] == a[lo]);
+        }
+    }
+}
+
+GTEST_TEST(sort, merge_sort)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0x0123456789ABCDEF);
+
+    static record a[5000];
+    static record buffer[2500];
+
+    // full buffer, a small buffer and in place all give the same stable order
+    for (size_t capacity : { size_t(2500), size_t(100), size_t(0) })
+    {
+        for (int pattern = 0; pattern < 8; ++pattern)
+        {
+            fill_pattern(a, CE_COUNTOF(a), pattern, g);
+            uint64_t s = key_sum(a, CE_COUNTOF(a));
+
+            ce::merge_sort(a, a + CE_COUNTOF(a), buffer, capacity);
+            GTEST_EXPECT_TRUE(key_sum(a, CE_COUNTOF(a)) == s);
+
+            bool stable = true;
+            for (size_t i = 1; i < CE_COUNTOF(a); ++i)
+                stable &= a[i - 1].key < a[i].key || (a[i - 1].key == a[i].key && a[i - 1].tag < a[i].tag);
+            GTEST_EXPECT_TRUE(stable);
+        }
+    }
+
+    // comparator and projection, descending by key
+    fill_pattern(a, CE_COUNTOF(a), 3, g);
+    ce::merge_sort(a, a + CE_COUNTOF(a), buffer, 0, [](uint32_t x, uint32_t y) { return y < x; }, [](record const& r) { return r.key; });
+    for (size_t i = 1; i < CE_COUNTOF(a); ++i)
+        GTEST_EXPECT_TRUE(a[i - 1].key > a[i].key || (a[i - 1].key == a[i].key && a[i - 1].tag < a[i].tag));
+}
+
+GTEST_TEST(sort, merge_n)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+
+    // runs tagged by run so stability across runs is visible
+    static record runs[5][300];
+    static record out[1500];
+    ce::span<record const> spans[5];
+
+    size_t total = 0;
+    for (uint32_t r = 0; r < 5; ++r)
+    {
+        size_t n = r == 2 ? 0 : 100 + r * 50;
+        for (size_t i = 0; i < n; ++i)
+            runs[r][i] = { next_unbiased(g, 50), r };
+        ce::intro_sort(runs[r], runs[r] + n);
+        spans[r] = { n, runs[r] };
+        total += n;
+    }
+
+    record* end = ce::merge_n<8>(5, spans, out);
+    GTEST_EXPECT_TRUE(size_t(end - out) == total);
+    for (size_t i = 1; i < total; ++i)
+        GTEST_EXPECT_TRUE(out[i - 1].key < out[i].key || (out[i - 1].key == out[i].key && out[i - 1].tag <= out[i].tag));
+}
+
+GTEST_TEST(sort, nth_element)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0x0123456789ABCDEF);
+
+    static record a[3000];
+    static record b[3000];
+    static record c[3000];
+
+    for (int pattern = 0; pattern < 8; ++pattern)
+    {
+        fill_pattern(c, CE_COUNTOF(c), pattern, g);
+        for (size_t i = 0; i < CE_COUNTOF(c); ++i)
+            b[i] = c[i];
+        ce::intro_sort(b, b + CE_COUNTOF(b));
+
+        for (size_t nth : { size_t(0), size_t(1), size_t(17), size_t(1500), size_t(2999) })
+        {
+            for (size_t i = 0; i < CE_COUNTOF(c); ++i)
+                a[i] = c[i];
+            ce::nth_element(a, a + nth, a + CE_COUNTOF(a));
+
+            GTEST_EXPECT_TRUE(a[nth].key == b[nth].key);
+            bool split = true;
+            for (size_t i = 0; i < nth; ++i)
+                split &= !(a[nth] < a[i]);
+            for (size_t i = nth + 1; i < CE_COUNTOF(a); ++i)
+                split &= !(a[i] < a[nth]);
+            GTEST_EXPECT_TRUE(split);
+
+            for (size_t i = 0; i < CE_COUNTOF(c); ++i)
+                a[i] = c[i];
+            ce::partial_sort(a, a + nth, a + CE_COUNTOF(a));
+            bool same = true;
+            for (size_t i = 0; i < nth; ++i)
+                same &= a[i].key == b[i].key;
+            GTEST_EXPECT_TRUE(same);
+        }
+    }
+}
+
+GTEST_TEST(sort, top_k)
+{
+    ce::random::pcg32_64_t g;
+    seed(g, 0xABCDEF0123456789);
+
+    static uint32_t a[10000];
+    for (auto& n : a) n = next(g);
+
+    ce::top_k<10, uint32_t> best;
+    best.reset();
+    for (size_t i = 0; i < 5; ++i)
+        best.push(a[i]);
+    GTEST_EXPECT_TRUE(best.size() == 5);
+    for (size_t i = 5; i < CE_COUNTOF(a); ++i)
+        best.push(a[i]);
+
+    uint32_t top[10];
+    GTEST_EXPECT_TRUE(best.drain(top) == 10);
+    GTEST_EXPECT_TRUE(best.size() == 0);
+
+    ce::intro_sort(a, a + CE_COUNTOF(a));
+    for (size_t i = 0; i < 10; ++i)
+        GTEST_EXPECT_TRUE(top[i] == a[CE_COUNTOF(a) - 1 - i]);
+
+    // reversed order keeps the smallest, by a projected key, moving items that can't be copied
+    struct greater { bool operator()(uint32_t x, uint32_t y) const { return y < x; } };
+    struct by_key { uint32_t operator()(move_only const& m) const { return m.key; } };
+
+    static ce::top_k<10, move_only, greater, by_key> least;
+    static uint32_t payloads[10000];
+    least.reset();
+    for (size_t i = 0; i < CE_COUNTOF(a); ++i)
+    {
+        move_only m;
+        m.key = a[(i * 7919) % CE_COUNTOF(a)];
+        m.payload = &payloads[i];
+        least.push(ce::move(m));
+    }
+
+    move_only low[10];
+    GTEST_EXPECT_TRUE(least.drain(low) == 10);
+    for (size_t i = 0; i < 10; ++i)
+        GTEST_EXPECT_TRUE(low[i].key == a[i] && low[i].payload != nullptr);
+}